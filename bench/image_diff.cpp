@@ -0,0 +1,35 @@
+#include "../include/ppm_image.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+/** Compares two PPM images of the same size.
+ *
+ *   image_diff <a.ppm> <b.ppm>
+ *
+ * Prints the root mean square error and the largest difference of a color component, both in 0..255 units. */
+int main(int argc, char* argv[]){
+    if (argc != 3)
+    {
+        std::cerr << "usage: image_diff <a.ppm> <b.ppm>\n";
+        return 2;
+    }
+
+    try {
+        std::ifstream file_a(argv[1], std::ios::binary), file_b(argv[2], std::ios::binary);
+        auto a = read_ppm(file_a);
+        auto b = read_ppm(file_b);
+
+        int max_difference = 0;
+        for (size_t i = 0; i < a.pixels.size() && i < b.pixels.size(); i++)
+            max_difference = std::max(max_difference, std::abs(int(a.pixels[i]) - int(b.pixels[i])));
+
+        std::cout << "RMSE " << image_rmse(a, b) << ", max difference " << max_difference << '\n';
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "../include/common.h"
+#include "../include/bvh.h"
+#include "../include/camera.h"
+#include "../include/light_tree.h"
+#include "../include/ppm_image.h"
+#include "../include/plane.h"
+#include "../include/sphere.h"
+#include "../include/two_level_scene.h"
+
+#include <chrono>
+#include <sstream>
+
+/** Convergence of direct lighting with the light tree against the number of lights.
+ *
+ *   light_tree_bench [width=120] [samples per pixel=16] [reference samples per pixel=256]
+ *
+ * The scene is a night scene: a ground, a few diffuse spheres, and L small lights scattered above them,
+ * with the same total power for every L. For each L the image is rendered once with many samples as the reference,
+ * then at the low sample count with the light tree and with plain BSDF sampling (no light sampling).
+ * The RMSE against the reference shows how the noise grows with L; the pick time shows the O(log L) cost. */
+static void night_scene(int light_count, hittable_list& world)
+{
+    world.add(make_shared<plane>(point3(0,0,0), vec3(0,1,0), make_shared<lambertian>(color(0.5, 0.5, 0.5))));
+    world.add(make_shared<sphere>(point3(-1.5,1,0), 1, make_shared<lambertian>(color(0.7, 0.3, 0.3))));
+    world.add(make_shared<sphere>(point3(1.5,1,0), 1, make_shared<lambertian>(color(0.3, 0.3, 0.7))));
+
+    auto emission = 60.0 / light_count; // the same total power for every light count
+    for (int i = 0; i < light_count; i++)
+    {
+        point3 position(random_double(-12, 12), random_double(0.3, 4), random_double(-12, 6));
+        auto tint = color(0.5, 0.5, 0.5) + 0.5 * color(random_double(), random_double(), random_double());
+        world.add(make_shared<sphere>(position, 0.05, make_shared<diffuse_light>(emission / (0.05*0.05) * tint)));
+    }
+}
+
+static ppm_image render(const hittable& world, Camera camera, int samples_per_pixel, double& ms)
+{
+    camera.samples_per_pixel = samples_per_pixel;
+    std::stringstream image;
+    auto start = std::chrono::steady_clock::now();
+    camera.render_tiled(world, image);
+    std::chrono::duration<double, std::milli> frame_time = std::chrono::steady_clock::now() - start;
+    ms = frame_time.count();
+    return read_ppm(image);
+}
+
+int main(int argc, char* argv[]){
+    int width = argc >= 2 ? std::atoi(argv[1]) : 120;
+    int samples = argc >= 3 ? std::atoi(argv[2]) : 16;
+    int reference_samples = argc >= 4 ? std::atoi(argv[3]) : 256;
+
+    std::cout << width << " px wide, " << samples << " spp against " << reference_samples << " spp references\n";
+    for (int light_count : {16, 256, 4096})
+    {
+        hittable_list objects;
+        night_scene(light_count, objects);
+        auto tree = make_shared<const light_tree>(objects);
+        hittable_list world(make_shared<two_level_scene>(objects));
+
+        Camera camera;
+        camera.image_width = width;
+        camera.aspect_ratio = 16.0 / 9.0;
+        camera.max_depth = 4;
+        camera.vfov = 40;
+        camera.look_from = point3(0, 3, 9);
+        camera.look_at = point3(0, 0.8, 0);
+        camera.sky = false;
+        camera.show_progress = false;
+        camera.lights = tree;
+
+        // the reference draws other random numbers than the measured renders: with the same seed its first samples
+        // would be theirs, and the error of the light tree render would come out too low
+        double ms;
+        camera.seed = 1;
+        auto reference = render(world, camera, reference_samples, ms);
+        camera.seed = 0;
+        double tree_ms, bsdf_ms;
+        auto with_tree = render(world, camera, samples, tree_ms);
+        camera.lights = nullptr;
+        auto bsdf_only = render(world, camera, samples, bsdf_ms);
+
+        // the cost of one pick, averaged over many points of the scene
+        const int picks = 200000;
+        double probability;
+        volatile double sink = 0; // keeps the compiler from dropping the picks
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < picks; i++)
+        {
+            point3 point(random_double(-10, 10), random_double(0, 3), random_double(-10, 5));
+            tree->sample(point, random_double(), probability);
+            sink = sink + probability;
+        }
+        std::chrono::duration<double, std::nano> pick_time = std::chrono::steady_clock::now() - start;
+
+        std::cout << light_count << " lights: light tree RMSE " << image_rmse(with_tree, reference) << " (" << tree_ms
+                  << " ms), BSDF only RMSE " << image_rmse(bsdf_only, reference) << " (" << bsdf_ms << " ms), "
+                  << pick_time.count() / picks << " ns per pick\n";
+    }
+    return 0;
+}
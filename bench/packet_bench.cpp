@@ -0,0 +1,47 @@
+#include "../include/common.h"
+#include "../include/bvh.h"
+#include "../include/camera.h"
+#include "../include/scenes.h"
+#include "../include/two_level_scene.h"
+
+#include <chrono>
+#include <sstream>
+
+/** Compares tracing camera rays one by one and in 8x8 packets on the random spheres scene.
+ *
+ *   packet_bench [width=400] [samples per pixel=4]
+ *
+ * The primary visibility pass (max_depth 1: camera rays only, the first hit ends the path) shows the packet
+ * traversal by itself; the full frame shows how much of a low-spp preview it is. */
+static double frame_ms(const hittable& world, Camera camera, bool packets, int max_depth)
+{
+    camera.packet_tracing = packets;
+    camera.max_depth = max_depth;
+
+    std::ostringstream image;
+    auto start = std::chrono::steady_clock::now();
+    camera.render_tiled(world, image);
+    std::chrono::duration<double, std::milli> frame_time = std::chrono::steady_clock::now() - start;
+    return frame_time.count();
+}
+
+int main(int argc, char* argv[]){
+    hittable_list world;
+    Camera camera;
+    random_spheres_scene(world, camera);
+    world = hittable_list(make_shared<two_level_scene>(world));
+
+    camera.image_width = argc >= 2 ? std::atoi(argv[1]) : 400;
+    camera.samples_per_pixel = argc >= 3 ? std::atoi(argv[2]) : 4;
+    camera.show_progress = false;
+
+    std::cout << camera.image_width << " px wide, " << camera.samples_per_pixel << " spp\n";
+    for (int max_depth : {1, camera.max_depth})
+    {
+        auto single = frame_ms(world, camera, false, max_depth);
+        auto packet = frame_ms(world, camera, true, max_depth);
+        std::cout << (max_depth == 1 ? "primary visibility" : "full frame        ") << "  single rays " << single
+                  << " ms, 8x8 packets " << packet << " ms\n";
+    }
+    return 0;
+}
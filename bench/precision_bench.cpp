@@ -0,0 +1,63 @@
+#include "../include/common.h"
+#include "../include/bvh.h"
+#include "../include/camera.h"
+#include "../include/scenes.h"
+#include "../include/sphere.h"
+#include "../include/two_level_scene.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+/** Renders the random spheres scene at the precision the benchmark was built with and reports the render time.
+ *
+ *   precision_bench_double [output.ppm] [width] [samples per pixel]
+ *   precision_bench_float  [output.ppm] [width] [samples per pixel]
+ *
+ * Both builds create the same scene from the same random sequence. Compare the two images with image_diff;
+ * at a high sample count the remaining difference is mostly the precision, at a low one mostly noise.
+ *
+ * Before rendering, edge cases of the intersection code are checked at the same precision; the benchmark exits with 1
+ * if one of them fails. */
+static bool check_tangent_ray_from_surface()
+/** A ray starting on the sphere and tangent to it has the double root t = 0, where the stable quadratic's c / q
+ * is 0 / 0. The hit must be at t = 0 for an interval containing 0, and there must be none for the usual (0, infinity). */
+{
+    sphere unit(point3(0,0,0), 1, make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+    ray tangent(point3(1,0,0), vec3(0,1,0));
+
+    hit_record record;
+    bool hit_around_zero = unit.hit(tangent, interval(-1, 1), record);
+    bool found_zero = hit_around_zero && record.t == 0;
+    bool hit_ahead = unit.hit(tangent, interval(0, infinity), record);
+
+    std::cout << "tangent ray from the surface: "
+              << (found_zero && !hit_ahead ? "ok" : "FAILED, the root is not t = 0") << '\n';
+    return found_zero && !hit_ahead;
+}
+
+int main(int argc, char* argv[]){
+    if (!check_tangent_ray_from_surface())
+        return 1;
+
+    hittable_list world;
+    Camera camera;
+    random_spheres_scene(world, camera);
+    world = hittable_list(make_shared<two_level_scene>(world));
+
+    camera.image_width = argc >= 3 ? std::atoi(argv[2]) : 400;
+    camera.samples_per_pixel = argc >= 4 ? std::atoi(argv[3]) : 32;
+    camera.show_progress = false;
+
+    std::ostringstream image;
+    auto start = std::chrono::steady_clock::now();
+    camera.render_tiled(world, image);
+    std::chrono::duration<double, std::milli> frame_time = std::chrono::steady_clock::now() - start;
+
+    std::cout << (sizeof(real) == sizeof(float) ? "float" : "double") << ": " << camera.image_width << " px wide, "
+              << camera.samples_per_pixel << " spp, " << frame_time.count() << " ms\n";
+
+    if (argc >= 2)
+        std::ofstream(argv[1], std::ios::binary) << image.str();
+    return 0;
+}
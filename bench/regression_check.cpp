@@ -0,0 +1,223 @@
+#include "../include/common.h"
+#include "../include/camera.h"
+#include "../include/hittable_list.h"
+#include "../include/ppm_image.h"
+#include "../include/scene_loader.h"
+#include "../include/scenes.h"
+#include "../include/two_level_scene.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Checks that a change neither altered the images nor slowed down the renderer.
+ *
+ *   regression_check [--record] [--record-baseline] [--data <dir>] [--tolerance <rmse>] [--slowdown <fraction>]
+ *
+ * Run from the repository root. The reference scenes are rendered small, with their own materials and lights
+ * but a fixed seed, width and sample count:
+ *   random_spheres  the scene of main.cpp
+ *   two_spheres     scenes/two_spheres.txt
+ *   night_lights    scenes/night_lights.txt, lit only by small lights
+ *
+ * For every scene:
+ * 1. determinism: the image rendered on one thread with 32 pixel tiles must equal, byte for byte, the image rendered
+ *    on all hardware threads (at least 4) with 16 pixel tiles;
+ * 2. image: the RMSE against the golden image <dir>/<scene>.ppm must not exceed --tolerance (default 1.0, 0..255 units);
+ * 3. speed: the rays per second on all hardware threads, the best of renders repeated for two seconds, must not fall
+ *    more than --slowdown (default 0.15) below the baseline in <dir>/baseline.txt. Without that file the speed is
+ *    reported but not checked.
+ *
+ * --record writes the golden images instead of checking them. --record-baseline writes baseline.txt instead of
+ * checking the speed. The baseline belongs to the machine it was recorded on and is not committed: record it on the
+ * machine, before the change to be checked. The default <dir> is "regression".
+ * Path guiding and the radiance cache are left off: they are not reproducible bit for bit.
+ * Exits with 1 if any check failed. */
+
+struct reference_scene {
+    std::string name;
+    std::function<void(hittable_list&, Camera&)> build;
+};
+
+static std::vector<reference_scene> reference_scenes()
+{
+    auto from_file = [](const std::string& path) {
+        return [path](hittable_list& world, Camera& camera) {
+            std::ifstream file(path);
+            if (!file)
+                throw std::runtime_error("cannot open " + path + ", run from the repository root");
+            load_scene(file, world, camera);
+        };
+    };
+
+    return {
+        {"random_spheres", [](hittable_list& world, Camera& camera) { random_spheres_scene(world, camera); }},
+        {"two_spheres", from_file("scenes/two_spheres.txt")},
+        {"night_lights", from_file("scenes/night_lights.txt")},
+    };
+}
+
+static ppm_image render(const hittable& world, Camera camera, int threads, int tile_size, double& rays_per_second)
+{
+    camera.render_threads = threads;
+    camera.tile_size = tile_size;
+    std::stringstream image;
+    auto start = std::chrono::steady_clock::now();
+    camera.render_tiled(world, image);
+    std::chrono::duration<double> frame_time = std::chrono::steady_clock::now() - start;
+    rays_per_second = double(camera.last_ray_count()) / frame_time.count();
+    return read_ppm(image);
+}
+
+static void write_ppm(const std::string& path, const ppm_image& image)
+{
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << image.width << ' ' << image.height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(image.pixels.data()), std::streamsize(image.pixels.size()));
+    if (!out)
+        throw std::runtime_error("cannot write " + path);
+}
+
+int main(int argc, char* argv[]){
+    bool record = false;
+    bool record_baseline = false;
+    std::string data_dir = "regression";
+    double tolerance = 1.0;
+    double slowdown = 0.15;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (std::strcmp(argv[arg], "--record") == 0)
+            record = true;
+        else if (std::strcmp(argv[arg], "--record-baseline") == 0)
+            record_baseline = true;
+        else if (std::strcmp(argv[arg], "--data") == 0 && arg + 1 < argc)
+            data_dir = argv[++arg];
+        else if (std::strcmp(argv[arg], "--tolerance") == 0 && arg + 1 < argc)
+            tolerance = std::atof(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--slowdown") == 0 && arg + 1 < argc)
+            slowdown = std::atof(argv[++arg]);
+        else
+        {
+            std::cerr << "usage: regression_check [--record] [--record-baseline] [--data <dir>] [--tolerance <rmse>]"
+                         " [--slowdown <fraction>]\n";
+            return 2;
+        }
+    }
+
+    const int width = 240;
+    const int samples = 16;
+    const int minimum_timed_renders = 3;
+    const double timed_seconds = 2;
+    int threads = std::max(4, int(std::thread::hardware_concurrency()));
+
+    std::map<std::string, double> baseline;
+    bool check_speed = false;
+    if (!record_baseline)
+    {
+        std::ifstream file(data_dir + "/baseline.txt");
+        check_speed = bool(file);
+        std::string name;
+        double rays_per_second;
+        while (file >> name >> rays_per_second)
+            baseline[name] = rays_per_second;
+    }
+    std::ostringstream new_baseline;
+
+    bool all_passed = true;
+    try {
+        for (const auto& scene : reference_scenes())
+        {
+            hittable_list objects;
+            Camera camera;
+            scene.build(objects, camera);
+            two_level_scene world(objects);
+
+            camera.image_width = width;
+            camera.samples_per_pixel = samples;
+            camera.seed = 1;
+            camera.path_guiding = false;
+            camera.radiance_caching = false;
+            camera.show_progress = false;
+
+            double rays_per_second;
+            auto single_thread = render(world, camera, 1, 32, rays_per_second);
+
+            // the first render on all threads is also the one compared with the single-threaded image
+            // short renders are repeated for at least timed_seconds, so a brief hiccup of the machine is not a slowdown
+            ppm_image all_threads;
+            double best_rays_per_second = 0;
+            auto timing_start = std::chrono::steady_clock::now();
+            for (int run = 0; run < minimum_timed_renders
+                              || std::chrono::steady_clock::now() - timing_start < std::chrono::duration<double>(timed_seconds); run++)
+            {
+                auto image = render(world, camera, threads, 16, rays_per_second);
+                if (run == 0)
+                    all_threads = image;
+                best_rays_per_second = std::max(best_rays_per_second, rays_per_second);
+            }
+
+            std::cout << scene.name << ": " << best_rays_per_second / 1e6 << " Mrays/s";
+            bool deterministic = single_thread.pixels == all_threads.pixels;
+            if (!deterministic)
+                std::cout << ", FAILED: 1 and " << threads << " threads give different images (RMSE "
+                          << image_rmse(single_thread, all_threads) << ")";
+
+            auto golden_path = data_dir + "/" + scene.name + ".ppm";
+            bool image_passed = true;
+            if (record)
+            {
+                write_ppm(golden_path, single_thread);
+                std::cout << ", image recorded";
+            }
+            else
+            {
+                std::ifstream golden_file(golden_path, std::ios::binary);
+                if (!golden_file)
+                    throw std::runtime_error("no golden image " + golden_path + ", record it with --record");
+                auto rmse = image_rmse(single_thread, read_ppm(golden_file));
+                image_passed = rmse <= tolerance;
+                std::cout << ", RMSE " << rmse << (image_passed ? "" : " FAILED");
+            }
+
+            bool speed_passed = true;
+            auto found = baseline.find(scene.name);
+            if (record_baseline)
+            {
+                new_baseline << scene.name << ' ' << best_rays_per_second << '\n';
+                std::cout << ", baseline recorded";
+            }
+            else if (!check_speed)
+                std::cout << ", speed not checked (no " << data_dir << "/baseline.txt)";
+            else if (found == baseline.end())
+                std::cout << ", no baseline";
+            else
+            {
+                auto change = best_rays_per_second / found->second - 1;
+                speed_passed = change >= -slowdown;
+                std::cout << ", " << (change >= 0 ? "+" : "") << 100 * change << "% against the baseline"
+                          << (speed_passed ? "" : " FAILED");
+            }
+            std::cout << '\n';
+            all_passed = all_passed && deterministic && image_passed && speed_passed;
+        }
+
+        if (record_baseline)
+        {
+            std::ofstream file(data_dir + "/baseline.txt");
+            file << new_baseline.str();
+            if (!file)
+                throw std::runtime_error("cannot write " + data_dir + "/baseline.txt");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return all_passed ? 0 : 1;
+}
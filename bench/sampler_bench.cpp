@@ -0,0 +1,86 @@
+#include "../include/common.h"
+#include "../include/bvh.h"
+#include "../include/camera.h"
+#include "../include/scenes.h"
+#include "../include/two_level_scene.h"
+
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+/** Compares the two kinds of samplers of vec3.h: the overloads without arguments, which draw their own random numbers
+ * and use rejection where it is faster, and the closed-form mappings of the overloads taking the uniform numbers.
+ *
+ *   sampler_bench [frame width]
+ *
+ * 1. ns per sample of every sampler, the closed-form ones with and without drawing the random numbers;
+ * 2. the time of a whole frame of the random spheres scene rendered with the current samplers.
+ * Build with optimizations (-O2 or -O3), otherwise the numbers say little. */
+
+// The unit vector of the original code: a point of the cube rejected until it is inside the sphere, then normalized.
+vec3 normalized_unit_vector()
+{
+    return unit_vector(random_in_unit_sphere());
+}
+
+template <typename Sampler>
+void measure(const char* name, int sample_count, Sampler sampler)
+/** Prints the average time per call; the sum of the samples keeps the compiler from dropping the calls. */
+{
+    vec3 sum;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < sample_count; i++)
+        sum += sampler(i);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "  " << name << ": " << elapsed.count() / sample_count << " ns/sample"
+              << "  (length of the mean " << sum.length() / sample_count << ")\n";
+}
+
+int main(int argc, char* argv[]){
+    const int sample_count = 4000000;
+    const vec3 normal = unit_vector(vec3(1, 2, 3));
+
+    // uniform numbers drawn in advance show the cost of the mapping alone, as with a precomputed sample sequence
+    std::vector<double> u(3 * sample_count);
+    for (auto& value : u)
+        value = random_double();
+
+    std::cout << "Samplers drawing their own numbers (rejection, Marsaglia, Malley on a rejected disk point):\n";
+    measure("random_in_unit_sphere  ", sample_count, [](int) { return random_in_unit_sphere(); });
+    measure("random_unit_vector     ", sample_count, [](int) { return random_unit_vector(); });
+    measure("random_in_unit_disk    ", sample_count, [](int) { return random_in_unit_disk(); });
+    measure("random_cosine_direction", sample_count, [&](int) { return random_cosine_direction(normal); });
+    measure("normalized unit vector ", sample_count, [](int) { return normalized_unit_vector(); });
+
+    std::cout << "Closed-form sampling (random numbers included):\n";
+    measure("random_in_unit_sphere  ", sample_count, [](int) { return random_in_unit_sphere(random_double(), random_double(), random_double()); });
+    measure("random_unit_vector     ", sample_count, [](int) { return random_unit_vector(random_double(), random_double()); });
+    measure("random_in_unit_disk    ", sample_count, [](int) { return random_in_unit_disk(random_double(), random_double()); });
+    measure("random_cosine_direction", sample_count, [&](int) { return random_cosine_direction(normal, random_double(), random_double()); });
+
+    std::cout << "Closed-form sampling (precomputed random numbers):\n";
+    measure("random_in_unit_sphere  ", sample_count, [&](int i) { return random_in_unit_sphere(u[3*i], u[3*i+1], u[3*i+2]); });
+    measure("random_unit_vector     ", sample_count, [&](int i) { return random_unit_vector(u[3*i], u[3*i+1]); });
+    measure("random_in_unit_disk    ", sample_count, [&](int i) { return random_in_unit_disk(u[3*i], u[3*i+1]); });
+    measure("random_cosine_direction", sample_count, [&](int i) { return random_cosine_direction(normal, u[3*i], u[3*i+1]); });
+
+    hittable_list world;
+    Camera camera;
+    random_spheres_scene(world, camera);
+    world = hittable_list(make_shared<two_level_scene>(world));
+
+    camera.image_width = argc >= 2 ? std::atoi(argv[1]) : 200;
+    camera.samples_per_pixel = 16;
+    camera.render_threads = 1;
+    camera.show_progress = false;
+
+    std::ostringstream image;
+    auto start = std::chrono::steady_clock::now();
+    camera.render_tiled(world, image);
+    std::chrono::duration<double, std::milli> frame_time = std::chrono::steady_clock::now() - start;
+    std::cout << "Frame " << camera.image_width << " px wide, " << camera.samples_per_pixel << " spp, 1 thread: "
+              << frame_time.count() << " ms\n";
+
+    return 0;
+}
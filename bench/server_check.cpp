@@ -0,0 +1,128 @@
+#include "../include/render_server.h"
+#include "../include/unix_socket.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/time.h>
+
+/** Checks that the render server survives bad requests.
+ *
+ *   server_check
+ *
+ * Starts a render server in the process on a socket in /tmp, sends it requests as project_6_client would and checks
+ * the replies: refused camera values and environment intensities, a request line without end, and a client served
+ * while as many idle clients as workers are connected. Every check prints one line; the program exits with 1 if any check failed. */
+
+static int connect_when_ready(const std::string& socket_path)
+/** The server thread may not be listening yet, so connecting is retried for a second. */
+{
+    for (int attempt = 0; ; attempt++)
+    {
+        try {
+            return connect_unix_socket(socket_path);
+        }
+        catch (const std::exception&) {
+            if (attempt == 100)
+                throw;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+static std::string request(int socket_fd, const std::string& line)
+{
+    std::string response;
+    if (!write_line(socket_fd, line) || !read_line(socket_fd, response))
+        return "connection lost";
+    return response;
+}
+
+int main(){
+    std::string socket_path = "/tmp/project_6_server_check.sock";
+    bool all_passed = true;
+    auto check = [&all_passed](const std::string& what, bool passed, const std::string& response) {
+        std::cout << what << ": " << (passed ? "ok" : "FAILED") << " (" << response << ")\n";
+        all_passed = all_passed && passed;
+    };
+    auto starts_with = [](const std::string& text, const std::string& prefix) {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    };
+
+    const int worker_count = 2;
+    render_server server(socket_path, worker_count);
+    std::thread server_thread([&server] { server.run(); });
+
+    try {
+        // as many idle clients as workers must not keep the server from answering anyone else
+        std::vector<int> idle_clients;
+        for (int i = 0; i < worker_count; i++)
+            idle_clients.push_back(connect_when_ready(socket_path));
+
+        int client = connect_when_ready(socket_path);
+        timeval timeout{5, 0}; // a server that never answers fails the check instead of hanging it
+        ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        auto response = request(client, "load s builtin:random_spheres");
+        check("load while " + std::to_string(worker_count) + " idle clients are connected", starts_with(response, "ok"), response);
+        response = request(client, "camera s image_width 32 samples_per_pixel 1 max_depth 3");
+        check("small camera", starts_with(response, "ok"), response);
+
+        // every value the renderer would divide by or loop over must be refused, leaving the camera as it was
+        for (const char* bad : {"tile_size 0", "image_width 0", "samples_per_pixel -1", "max_depth 0",
+                                "aspect_ratio 0", "vfov 0", "guiding_cell_size 0", "radiance_cache_cell_size 0"})
+        {
+            response = request(client, std::string("camera s ") + bad);
+            check(bad, starts_with(response, "error") && response.find("must be") != std::string::npos, response);
+        }
+
+        // an environment intensity that is not a positive number must fail the load, not render a black image
+        for (const char* intensity : {"bright", "-3", "0", "inf", "nan"})
+        {
+            std::string scene_path = "/tmp/project_6_server_check.txt";
+            std::ofstream(scene_path) << "environment /tmp/project_6_server_check.hdr " << intensity << '\n';
+            response = request(client, "load bad " + scene_path);
+            check(std::string("environment intensity ") + intensity,
+                  starts_with(response, "error") && response.find("environment intensity") != std::string::npos, response);
+        }
+
+        // a line without end must not grow the server's buffer forever
+        int flooding_client = connect_when_ready(socket_path);
+        ::setsockopt(flooding_client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        std::string flood(16384, 'x');
+        response = ::write(flooding_client, flood.data(), flood.size()) > 0 && read_line(flooding_client, response)
+                   ? response : "connection lost";
+        std::string after_error;
+        bool closed = !read_line(flooding_client, after_error);
+        check("request too long", starts_with(response, "error") && response.find("too long") != std::string::npos
+                                  && closed, response);
+        ::close(flooding_client);
+
+        response = request(client, "render s /tmp/project_6_server_check.ppm");
+        check("render after the refused changes", starts_with(response, "ok"), response);
+
+        // the idle clients are still connected; the server must stop anyway, or join() below never returns
+        response = request(client, "shutdown");
+        check("shutdown", starts_with(response, "ok"), response);
+        ::close(client);
+        for (int idle : idle_clients)
+            ::close(idle);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        all_passed = false;
+        try {
+            request(connect_unix_socket(socket_path), "shutdown"); // the server must stop, or join() never returns
+        }
+        catch (const std::exception&) {
+            server_thread.detach();
+            return 1;
+        }
+    }
+
+    server_thread.join();
+    return all_passed ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+
+#ifndef PROJECT_6_AABB_H
+#define PROJECT_6_AABB_H
+
+#include "common.h"
+
+/** An axis-aligned bounding box (AABB) is the intersection of three axis-aligned intervals (slabs).
+ * Testing a ray against a box is much cheaper than testing it against everything inside the box:
+ * if the ray misses the box, it misses all the objects it contains.
+ *
+ * "To check if a ray hits the box we need to know whether the t-intervals of the ray for the three slabs overlap.
+ * If they do, the ray is inside all three slabs at the same time, so it is inside the box."
+ */
+class aabb {
+public:
+    interval x, y, z;
+
+    aabb() = default; // The default AABB is empty, since intervals are empty by default.
+
+    aabb(const interval& x, const interval& y, const interval& z) : x(x), y(y), z(z)
+    {
+        pad_to_minimums();
+    }
+
+    aabb(const point3& a, const point3& b)
+    /** Treats the two points a and b as extrema for the bounding box, so we don't require a particular min/max coordinate order. */
+    {
+        x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
+        y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
+        z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+
+        pad_to_minimums();
+    }
+
+    aabb(const aabb& box0, const aabb& box1)
+    /** Creates the box tightly enclosing the two input boxes. */
+            : x(box0.x, box1.x), y(box0.y, box1.y), z(box0.z, box1.z) {}
+
+    const interval& axis_interval(int n) const
+    {
+        if (n == 1) return y;
+        if (n == 2) return z;
+        return x;
+    }
+
+    bool hit(const ray& r, interval ray_t) const
+    /** Shrinks the ray interval slab by slab; the ray hits the box if anything is left of it at the end. */
+    {
+        const point3& ray_orig = r.origin();
+        const vec3&   ray_dir  = r.direction();
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const interval& ax = axis_interval(axis);
+            // division by zero gives +/- infinity, which still produces the correct slab interval
+            const real adinv = 1 / ray_dir[axis];
+
+            auto t0 = (ax.min - ray_orig[axis]) * adinv;
+            auto t1 = (ax.max - ray_orig[axis]) * adinv;
+
+            // a ray travelling in the negative direction enters the slab through its max plane
+            if (t0 < t1)
+            {
+                if (t0 > ray_t.min) ray_t.min = t0;
+                if (t1 < ray_t.max) ray_t.max = t1;
+            }
+            else
+            {
+                if (t1 > ray_t.min) ray_t.min = t1;
+                if (t0 < ray_t.max) ray_t.max = t0;
+            }
+
+            if (ray_t.max <= ray_t.min)
+                return false;
+        }
+        return true;
+    }
+
+    int longest_axis() const
+    /** Returns the index of the longest axis of the bounding box. */
+    {
+        if (x.size() > y.size())
+            return x.size() > z.size() ? 0 : 2;
+        else
+            return y.size() > z.size() ? 1 : 2;
+    }
+
+    static const aabb empty, universe;
+
+private:
+    void pad_to_minimums()
+    /** Adjusts the AABB so that no side is narrower than some delta, padding if necessary.
+     * A flat box would make the slab test unstable for rays parallel to it. */
+    {
+        real delta = 0.0001;
+        if (x.size() < delta) x = x.expand(delta);
+        if (y.size() < delta) y = y.expand(delta);
+        if (z.size() < delta) z = z.expand(delta);
+    }
+};
+
+const aabb aabb::empty    = aabb(interval::empty,    interval::empty,    interval::empty);
+const aabb aabb::universe = aabb(interval::universe, interval::universe, interval::universe);
+
+#endif //PROJECT_6_AABB_H
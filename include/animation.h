@@ -0,0 +1,126 @@
+
+#ifndef PROJECT_6_ANIMATION_H
+#define PROJECT_6_ANIMATION_H
+
+#include "common.h"
+
+#include "camera.h"
+#include "hittable.h"
+#include "sphere.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** Keyframe animation: a value is given at a few points in time (keyframes), and every frame in between
+ * blends linearly between the two surrounding keyframes. Before the first and after the last keyframe the value holds.
+ * T must support T + T and double * T, which is the case for double and vec3. */
+template <typename T>
+class keyframe_track {
+public:
+    void add(double time, const T& value)
+    /** Adds a keyframe. Keyframes have to be added in increasing time order. */
+    {
+        keys.push_back({time, value});
+    }
+
+    bool empty() const { return keys.empty(); }
+
+    T at(double time) const
+    {
+        if (time <= keys.front().time)
+            return keys.front().value;
+        if (time >= keys.back().time)
+            return keys.back().value;
+
+        size_t next = 1;
+        while (keys[next].time < time)
+            next++;
+
+        const auto& a = keys[next - 1];
+        const auto& b = keys[next];
+        auto blend = (time - a.time) / (b.time - a.time);
+        return (1.0 - blend) * a.value + blend * b.value;
+    }
+
+private:
+    struct keyframe {
+        double time;
+        T value;
+    };
+    std::vector<keyframe> keys;
+};
+
+/** Describes how the camera and the scene objects change over time. Tracks without keyframes leave the value as is. */
+class animation {
+public:
+    keyframe_track<point3> look_from;
+    keyframe_track<point3> look_at;
+    keyframe_track<double> vfov;
+    keyframe_track<double> defocus_angle;
+    keyframe_track<double> focus_dist;
+
+    void add_motion(shared_ptr<sphere> object, const keyframe_track<point3>& path)
+    /** Moves the sphere's center along the path. */
+    {
+        motions.push_back({std::move(object), path});
+    }
+
+    void apply(double time, Camera& camera, hittable& world) const
+    /** Poses the camera and the objects for the time, then refits the acceleration structures of the world. */
+    {
+        if (!look_from.empty())     camera.look_from = look_from.at(time);
+        if (!look_at.empty())       camera.look_at = look_at.at(time);
+        if (!vfov.empty())          camera.vfov = vfov.at(time);
+        if (!defocus_angle.empty()) camera.defocus_angle = defocus_angle.at(time);
+        if (!focus_dist.empty())    camera.focus_dist = focus_dist.at(time);
+
+        if (motions.empty())
+            return;
+        for (const auto& motion : motions)
+            motion.object->move_to(motion.path.at(time));
+        world.refit();
+    }
+
+    void render(Camera& camera, hittable& world, int frame_count, double frames_per_second,
+                const std::string& output_prefix) const
+    /** Renders the frames <output_prefix>0000.ppm, <output_prefix>0001.ppm, ... in one process.
+     * The scene, its BVH, the render threads and the tile buffers are set up once and reused by every frame,
+     * so the work per frame is the refit and the tracing itself. */
+    {
+        int thread_count = camera.render_threads > 0 ? camera.render_threads : int(std::thread::hardware_concurrency());
+        render_context context(thread_count);
+        bool show_progress = camera.show_progress;
+        camera.show_progress = false;
+
+        for (int frame = 0; frame < frame_count; frame++)
+        {
+            apply(frame / frames_per_second, camera, world);
+
+            char file_name[16];
+            std::snprintf(file_name, sizeof(file_name), "%04d.ppm", frame);
+            std::ofstream out(output_prefix + file_name, std::ios::binary);
+            if (!out)
+                throw std::runtime_error("cannot open " + output_prefix + file_name + " for writing");
+
+            camera.render_tiled(world, out, context);
+            if (show_progress)
+                std::clog << "\rFrames remaining: " << (frame_count - frame - 1) << ' ' << std::flush;
+        }
+
+        camera.show_progress = show_progress;
+        if (show_progress)
+            std::clog << "\rDone.                 \n";
+    }
+
+private:
+    struct motion {
+        shared_ptr<sphere> object;
+        keyframe_track<point3> path;
+    };
+    std::vector<motion> motions;
+};
+
+#endif //PROJECT_6_ANIMATION_H
@@ -0,0 +1,103 @@
+
+#ifndef PROJECT_6_BVH_H
+#define PROJECT_6_BVH_H
+
+#include "common.h"
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+
+/** A bounding volume hierarchy (BVH) is a binary tree of bounding boxes over the scene objects.
+ * Every node's box encloses the boxes of its two children, and the leaves are the objects themselves.
+ * A ray that misses a node's box skips the whole subtree, so the number of intersection tests grows
+ * roughly with the logarithm of the object count instead of linearly as in hittable_list.
+ *
+ * The tree is only read while rendering, so one BVH can be shared by any number of render threads.
+ * Between animation frames it is refitted to the moved objects instead of being rebuilt.
+ */
+class bvh_node : public hittable {
+public:
+    explicit bvh_node(hittable_list list) : bvh_node(list.objects, 0, list.objects.size())
+    {
+        // There's a C++ subtlety here. This constructor (without span indices) creates an implicit copy of the
+        // hittable list, which we will modify. The lifetime of the copied list only extends until this constructor exits.
+    }
+
+    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end)
+    /** Builds the subtree over objects[start, end) by splitting them in half along the longest axis of their bounds. */
+    {
+        bbox = aabb::empty;
+        for (size_t object_index = start; object_index < end; object_index++)
+            bbox = aabb(bbox, objects[object_index]->bounding_box());
+
+        int axis = bbox.longest_axis();
+        size_t object_span = end - start;
+
+        if (object_span == 1)
+        {
+            left = right = objects[start];
+        }
+        else if (object_span == 2)
+        {
+            left = objects[start];
+            right = objects[start+1];
+        }
+        else
+        {
+            auto comparator = [axis](const shared_ptr<hittable>& a, const shared_ptr<hittable>& b)
+            {
+                return a->bounding_box().axis_interval(axis).min < b->bounding_box().axis_interval(axis).min;
+            };
+            std::sort(objects.begin() + start, objects.begin() + end, comparator);
+
+            auto mid = start + object_span/2;
+            left = make_shared<bvh_node>(objects, start, mid);
+            right = make_shared<bvh_node>(objects, mid, end);
+        }
+    }
+
+    bool hit(const ray& ray, interval ray_t_interval, hit_record& record) const override
+    /** Tests the children only if the ray hits the node's box. The right child is searched only up to the left hit,
+     * since anything behind it cannot be the closest hit. */
+    {
+        if (!bbox.hit(ray, ray_t_interval))
+            return false;
+
+        bool hit_left = left->hit(ray, ray_t_interval, record);
+        bool hit_right = right->hit(ray, interval(ray_t_interval.min, hit_left ? record.t : ray_t_interval.max), record);
+
+        return hit_left || hit_right;
+    }
+
+    void hit_packet(ray_packet& packet) const override
+    /** The whole subtree is skipped when no ray of the packet can hit the node's box. */
+    {
+        if (!packet.may_hit(bbox))
+            return;
+
+        left->hit_packet(packet);
+        if (right != left)
+            right->hit_packet(packet);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    aabb refit() override
+    /** Updates the node boxes bottom-up after objects moved, keeping the tree topology.
+     * Refitting visits every node once, which is much cheaper than sorting the objects again for a new tree.
+     * The tree gets less efficient when objects move far from their neighbours, since the boxes start to overlap. */
+    {
+        bbox = aabb(left->refit(), right->refit());
+        return bbox;
+    }
+
+private:
+    shared_ptr<hittable> left;
+    shared_ptr<hittable> right;
+    aabb bbox;
+};
+
+#endif //PROJECT_6_BVH_H
@@ -4,8 +4,32 @@
 
 #include "common.h"
 
+#include "environment_map.h"
 #include "hittable.h"
+#include "light_tree.h"
 #include "material.h"
+#include "path_guiding.h"
+#include "radiance_cache.h"
+#include "thread_pool.h"
+#include "tile_writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/** Resources that outlive a single render: the worker threads, the tile row buffers and the tables of the path guide
+ * and the radiance cache. Rendering a sequence of images with one context avoids starting threads and allocating
+ * buffers for every image; the tables are created by the first render that uses them and cleared for every later one. */
+class render_context {
+public:
+    explicit render_context(int render_threads) : workers(render_threads) {}
+
+    thread_pool workers;   // the writer and render_threads - 1 render helpers; the calling thread renders as well
+    tile_row_queue rows;
+    shared_ptr<path_guide> guide;
+    shared_ptr<radiance_cache> cache;
+};
 
 class Camera{
 public:
@@ -27,35 +51,179 @@ public:
      * For this model, however, these two will have the same value, as we will put our pixel grid right on the focus plane.
      */
 
+    int tile_size           = 32;  // Width and height of a tile in pixels for tiled rendering
+    int render_threads      = 0;   // Number of threads rendering tiles, 0 means one per hardware thread
+    int tile_rows_in_flight = 4;   // Tile rows kept in memory at once while streaming tiled output
+    bool show_progress      = true; // Report the remaining scanlines / tile rows to std::clog
+    bool packet_tracing     = true; // Tiled renders trace the camera rays of 8x8 pixel blocks as packets
+    unsigned seed           = 0;    // Seed of the random numbers; one seed gives the same image on any number of threads
+
+    shared_ptr<const environment_map> environment; // Light from far away for rays leaving the scene, nullptr keeps the sky gradient
+    shared_ptr<const light_tree> lights;           // Emissive objects sampled directly at diffuse hits, nullptr samples none
+    bool   sky = true;                             // Without an environment, rays leaving the scene see the sky gradient or black
+
+    // Path guiding and the radiance cache learn from the samples of all threads in the order they finish,
+    // so images rendered with them are not reproducible bit for bit.
+    bool   path_guiding            = false; // Learn where light comes from and guide diffuse bounces towards it
+    int    guiding_training_passes = 4;     // Passes of one sample per pixel that train the guide before rendering
+    double guiding_fraction        = 0.3;   // Share of diffuse bounces sampled from the guide, the rest follow cos(theta)
+    double guiding_cell_size       = 2.0;   // Edge length of the guide's spatial cells in world units
+
+    bool   radiance_caching             = false; // End paths at diffuse hits with the cached incoming light where known
+    int    radiance_cache_after_bounces = 1;     // Bounces traced in full before the cache may end a path
+    double radiance_cache_cell_size     = 0.04;  // Cache cell edge per unit of distance from the camera, smaller is less biased
+
     void render(const hittable& world)
     /** Renders 3D scene with world objects.*/
     {
-        initialize();
+        // the scanlines render on this thread; the threads of the context only train the path guide
+        int thread_count = render_threads > 0 ? render_threads : int(std::thread::hardware_concurrency());
+        render_context context(path_guiding ? thread_count : 1);
+        initialize(context);
+        train_path_guide(world, context);
 
         std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+        auto rays_before = thread_ray_count();
 
         for (int j = 0; j < image_height; j++)
         {
-            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
+            if (show_progress)
+                std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
 
             for (int i = 0; i < image_width; i++)
+                write_color(std::cout, render_pixel(i, j, world));
+        }
+        rays_traced = thread_ray_count() - rays_before;
+
+        if (show_progress)
+            std::clog << "\rDone.                 \n";
+    }
+
+    void render_tiled(const hittable& world, std::ostream& out)
+    /** Renders 3D scene with world objects tile by tile on several threads and streams a binary PPM into 'out'.
+     * Finished tile rows are written by a separate writer thread while the render threads continue with the next rows,
+     * so only 'tile_rows_in_flight' tile rows are held in memory regardless of the image size. */
+    {
+        int thread_count = render_threads > 0 ? render_threads : int(std::thread::hardware_concurrency());
+        render_context context(thread_count);
+        render_tiled(world, out, context);
+    }
+
+    void render_tiled(const hittable& world, std::ostream& out, render_context& context)
+    /** Same as above, but runs on the threads, tile row buffers and tables of the context, which are reused between calls. */
+    {
+        initialize(context);
+        train_path_guide(world, context);
+
+        int tiles_per_row = (image_width + tile_size - 1) / tile_size;
+        int tile_row_count = (image_height + tile_size - 1) / tile_size;
+        int tile_count = tiles_per_row * tile_row_count;
+
+        tile_row_queue& queue = context.rows;
+        queue.reset(image_width, image_height, tile_size, tiles_per_row, tile_rows_in_flight);
+        ppm_stream_writer writer(out, image_width, image_height);
+
+        context.workers.submit([&]
+        {
+            const unsigned char* pixels;
+            int rows;
+            while (queue.wait_next(pixels, rows))
+            {
+                if (show_progress)
+                    std::clog << "\rTile rows remaining: " << queue.rows_remaining() << ' ' << std::flush;
+                writer.write_rows(pixels, rows);
+                queue.release();
+            }
+        });
+
+        // tiles are handed out in row-major order, so all render threads stay within the few tile rows kept in memory
+        std::atomic<int> next_tile(0);
+        std::atomic<uint64_t> ray_count(0);
+        auto render_tiles = [&]
+        {
+            auto rays_before = thread_ray_count();
+            for (int tile = next_tile++; tile < tile_count; tile = next_tile++)
+            {
+                int tile_row = tile / tiles_per_row;
+                unsigned char* pixels = queue.acquire(tile_row);
+                render_tile(world, tile_row, tile % tiles_per_row, pixels);
+                queue.complete_tile(tile_row);
+            }
+            ray_count += thread_ray_count() - rays_before;
+        };
+
+        // one worker is busy writing, the others render together with the calling thread
+        for (int t = 1; t < context.workers.size(); t++)
+            context.workers.submit(render_tiles);
+        render_tiles();
+
+        context.workers.wait_idle();
+        out.flush();
+        rays_traced = ray_count;
+
+        if (show_progress)
+            std::clog << "\rDone.                 \n";
+    }
+
+    bool render_pass(const hittable& world, std::vector<color>& sums, int first_sample, render_context& context,
+                     const std::atomic<bool>& cancel)
+    /** Adds samples_per_pixel samples of every pixel to sums, which holds one color per pixel row by row and is
+     * resized to the image if needed. Used by the interactive preview (progressive_preview.h), which adds pass after pass;
+     * first_sample is the number of samples of earlier passes, so every pass draws new random numbers.
+     * The image is split into packet blocks that all threads of the context take one by one; between two blocks every
+     * thread checks 'cancel', so a cancelled pass returns within about the time of one block. Returns false if the pass
+     * was cancelled, the sums are then incomplete. No path guide is trained, and the radiance cache starts empty. */
+    {
+        initialize(context);
+        sample_offset = first_sample;
+        sums.resize(size_t(image_width) * image_height);
+
+        int blocks_per_row = (image_width + packet_block_size - 1) / packet_block_size;
+        int block_count = blocks_per_row * ((image_height + packet_block_size - 1) / packet_block_size);
+
+        std::atomic<int> next_block(0);
+        auto render_blocks = [&]
+        {
+            color pixel_colors[ray_packet::max_rays];
+            for (int block = next_block++; block < block_count && !cancel.load(std::memory_order_relaxed); block = next_block++)
             {
-                color pixel_color(0,0,0);
+                int first_i = (block % blocks_per_row) * packet_block_size;
+                int first_j = (block / blocks_per_row) * packet_block_size;
+                int last_i = std::min(first_i + packet_block_size, image_width);
+                int last_j = std::min(first_j + packet_block_size, image_height);
 
-                // to perform anti-aliasing we need to send multiple rays into the square region centered at the pixel
-                // to generate several samples for each pixel
-                // More about anti-aliasing here: https://learnopengl.com/Advanced-OpenGL/Anti-Aliasing
-                for (int sample = 0; sample < samples_per_pixel; sample++)
+                int k = 0;
+                if (packet_tracing)
                 {
-                    ray new_ray = generate_ray(i, j);
-                    pixel_color += define_ray_color(new_ray, max_depth, world);
+                    std::fill(pixel_colors, pixel_colors + ray_packet::max_rays, color(0,0,0));
+                    trace_packet_block(world, first_i, first_j, last_i, last_j, pixel_colors);
                 }
-                // pixel color to be written in the file is the sum of samples' color values per pixel divided by number of samples per pixel
-                write_color(std::cout, pixel_samples_scale * pixel_color);
+                for (int j = first_j; j < last_j; j++)
+                    for (int i = first_i; i < last_i; i++, k++)
+                        sums[size_t(j) * image_width + i] += packet_tracing ? pixel_colors[k]
+                                                                            : samples_per_pixel * render_pixel(i, j, world);
             }
-        }
+        };
+
+        for (int t = 1; t < context.workers.size(); t++)
+            context.workers.submit(render_blocks);
+        render_blocks();
+        context.workers.wait_idle();
 
-        std::clog << "\rDone.                 \n";
+        return !cancel.load();
+    }
+
+    int rendered_height() const
+    /** Height of the rendered image for the image width and aspect ratio. */
+    {
+        int height = int(image_width / aspect_ratio);
+        return (height < 1) ? 1 : height; // the resulting height should be at least 1.
+    }
+
+    uint64_t last_ray_count() const
+    /** Rays traced into the scene by the last render() or render_tiled(): camera rays, bounces and shadow rays. */
+    {
+        return rays_traced;
     }
 
 private:
@@ -70,12 +238,22 @@ private:
     vec3   defocus_disk_u;       // Defocus disk horizontal radius
     vec3   defocus_disk_v;       // Defocus disk vertical radius
 
+    static const int packet_block_size = 8; // packet_block_size^2 must not exceed ray_packet::max_rays
+
+    // the random number streams of one pixel sample, see seed_sample
+    enum random_stream { camera_ray_stream, path_stream, training_stream };
+    int sample_offset = 0;         // Index of the first sample of a render_pass
+    uint64_t rays_traced = 0;      // Rays of the last render, see last_ray_count
 
-    void initialize()
-    /** Initializes Camera parameters for further rendering. */
+    shared_ptr<path_guide> guide;  // Learned incoming light, the table of the context while path guiding is on
+    bool guide_learning = false;   // Training passes record the radiance of diffuse bounces into the guide
+    shared_ptr<radiance_cache> cache; // Incoming light at diffuse surfaces, the table of the context while radiance caching is on
+
+
+    void initialize(render_context& context)
+    /** Initializes Camera parameters for further rendering, and empties the radiance cache of the context. */
     {
-        image_height = int(image_width / aspect_ratio);
-        image_height = (image_height < 1) ? 1 : image_height; // the resulting height should be at least 1.
+        image_height = rendered_height();
 
         pixel_samples_scale = 1.0 / samples_per_pixel;
 
@@ -120,11 +298,177 @@ private:
         auto defocus_radius = focus_dist * std::tan(degrees_to_radians(defocus_angle / 2));
         defocus_disk_u = camera_right * defocus_radius;
         defocus_disk_v = camera_up * defocus_radius;
+
+        cache = nullptr;
+        if (radiance_caching)
+        {
+            if (context.cache)
+                context.cache->clear(radiance_cache_cell_size, center);
+            else
+                context.cache = make_shared<radiance_cache>(radiance_cache_cell_size, center);
+            cache = context.cache;
+        }
+        sample_offset = 0;
+    }
+
+    void seed_sample(int i, int j, int sample, random_stream stream) const
+    /** Seeds the random numbers of the calling thread for one sample of the pixel i, j. The numbers then depend only
+     * on the seed, the pixel, the sample and the stream, never on the thread or the order of the tiles, so the image is
+     * the same for any render_threads and tile_size. The camera ray and the rest of the path use separate streams,
+     * because packet tracing generates all camera rays of a block before it follows the first path. */
+    {
+        uint64_t key = mix_bits(uint64_t(seed) + 0x9e3779b97f4a7c15ULL);
+        key = mix_bits(key ^ (uint64_t(j) * uint64_t(image_width) + uint64_t(i)));
+        seed_random(key ^ (uint64_t(sample_offset + sample) * 4 + stream));
+    }
+
+    static uint64_t& thread_ray_count()
+    /** Rays traced by the calling thread so far; render threads add their difference to the render's total. */
+    {
+        thread_local uint64_t count = 0;
+        return count;
+    }
+
+    void train_path_guide(const hittable& world, render_context& context)
+    /** Renders a few passes of one sample per pixel on the threads of the context, recording where the light of every
+     * diffuse bounce came from. The guide is updated after each pass, so later training passes already sample with what
+     * was learned and record more of the important directions. The training images are thrown away. */
+    {
+        guide = nullptr;
+        if (!path_guiding)
+            return;
+        if (context.guide)
+            context.guide->clear(guiding_cell_size);
+        else
+            context.guide = make_shared<path_guide>(guiding_cell_size);
+        guide = context.guide;
+        guide_learning = true;
+
+        for (int pass = 0; pass < guiding_training_passes; pass++)
+        {
+            if (show_progress)
+                std::clog << "\rPath guiding training passes remaining: " << (guiding_training_passes - pass) << ' ' << std::flush;
+
+            std::atomic<int> next_row(0);
+            auto train_rows = [&]
+            {
+                for (int j = next_row++; j < image_height; j = next_row++)
+                    for (int i = 0; i < image_width; i++)
+                    {
+                        seed_sample(i, j, pass, training_stream);
+                        define_ray_color(generate_ray(i, j), max_depth, world);
+                    }
+            };
+
+            for (int t = 1; t < context.workers.size(); t++)
+                context.workers.submit(train_rows);
+            train_rows();
+            context.workers.wait_idle();
+
+            guide->update();
+        }
+        guide_learning = false;
+    }
+
+    color render_pixel(int i, int j, const hittable& world) const
+    /** Returns the averaged color of all samples taken for the pixel i, j. */
+    {
+        color pixel_color(0,0,0);
+
+        // to perform anti-aliasing we need to send multiple rays into the square region centered at the pixel
+        // to generate several samples for each pixel
+        // More about anti-aliasing here: https://learnopengl.com/Advanced-OpenGL/Anti-Aliasing
+        for (int sample = 0; sample < samples_per_pixel; sample++)
+        {
+            seed_sample(i, j, sample, camera_ray_stream);
+            ray new_ray = generate_ray(i, j);
+            seed_sample(i, j, sample, path_stream);
+            pixel_color += define_ray_color(new_ray, max_depth, world);
+        }
+        // pixel color to be written in the file is the sum of samples' color values per pixel divided by number of samples per pixel
+        return pixel_samples_scale * pixel_color;
     }
 
-    color define_ray_color(const ray& in_ray, int depth, const hittable& world) const
+    void render_tile(const hittable& world, int tile_row, int tile_column, unsigned char* row_pixels) const
+    /** Renders one tile into the 8-bit RGB buffer of its tile row. */
+    {
+        int first_j = tile_row * tile_size;
+        int first_i = tile_column * tile_size;
+        int last_j = std::min(first_j + tile_size, image_height);
+        int last_i = std::min(first_i + tile_size, image_width);
+
+        if (!packet_tracing)
+        {
+            for (int j = first_j; j < last_j; j++)
+                for (int i = first_i; i < last_i; i++)
+                    color_to_bytes(render_pixel(i, j, world), row_pixels + (size_t(j - first_j) * image_width + i) * 3);
+            return;
+        }
+
+        for (int block_j = first_j; block_j < last_j; block_j += packet_block_size)
+            for (int block_i = first_i; block_i < last_i; block_i += packet_block_size)
+                render_packet_block(world, block_i, block_j, std::min(block_i + packet_block_size, last_i),
+                                    std::min(block_j + packet_block_size, last_j),
+                                    row_pixels + (size_t(block_j - first_j) * image_width + block_i) * 3);
+    }
+
+    void render_packet_block(const hittable& world, int first_i, int first_j, int last_i, int last_j,
+                             unsigned char* block_pixels) const
+    /** Renders a block of up to packet_block_size x packet_block_size pixels into the 8-bit RGB buffer of its tile row. */
+    {
+        color pixel_colors[ray_packet::max_rays];
+        trace_packet_block(world, first_i, first_j, last_i, last_j, pixel_colors);
+
+        int block_width = last_i - first_i;
+        int block_pixel_count = block_width * (last_j - first_j);
+        for (int k = 0; k < block_pixel_count; k++)
+            color_to_bytes(pixel_samples_scale * pixel_colors[k],
+                           block_pixels + (size_t(k / block_width) * image_width + k % block_width) * 3);
+    }
+
+    void trace_packet_block(const hittable& world, int first_i, int first_j, int last_i, int last_j,
+                            color* pixel_colors) const
+    /** Adds samples_per_pixel samples to the colors of the block's pixels, row by row. For every sample, the camera rays
+     * of all pixels of the block are traced together as one packet (ray_packet.h); each ray then continues alone
+     * from its hit. */
+    {
+        ray_packet packet;
+        hit_record record;
+
+        for (int sample = 0; sample < samples_per_pixel; sample++)
+        {
+            packet.clear();
+            for (int j = first_j; j < last_j; j++)
+                for (int i = first_i; i < last_i; i++)
+                {
+                    seed_sample(i, j, sample, camera_ray_stream);
+                    packet.add(generate_ray(i, j));
+                }
+            packet.prepare();
+            world.hit_packet(packet);
+            thread_ray_count() += packet.count;
+
+            int block_width = last_i - first_i;
+            for (int k = 0; k < packet.count; k++)
+            {
+                const ray& camera_ray = packet.rays[k];
+                if (max_depth <= 0)
+                    continue;
+                seed_sample(first_i + k % block_width, first_j + k / block_width, sample, path_stream);
+                // the packet only kept the distance; the hit record is computed again on the object that was hit
+                if (packet.hit_object[k] && packet.hit_object[k]->hit(camera_ray, interval(0, infinity), record))
+                    pixel_colors[k] += hit_color(camera_ray, record, max_depth, world);
+                else
+                    pixel_colors[k] += background_color(camera_ray);
+            }
+        }
+    }
+
+    color define_ray_color(const ray& in_ray, int depth, const hittable& world, double bounce_pdf = 0) const
     /** Calculates a pixel color value by following the lifecycle of the ray until it fails to hit any object or
-     * it reaches the maximum number of ray bounces.*/
+     * it reaches the maximum number of ray bounces.
+     * bounce_pdf is the density with which a diffuse bounce chose the ray while the lights were also sampled
+     * from the same point, 0 for every other ray (see direct_environment_light and direct_light). */
     {
         // If we've exceeded the ray bounce limit, no more light is gathered.
         // If the maximum number of ray bounces is not set, ray bouncing stops when ray fails to hit anything.
@@ -132,26 +476,59 @@ private:
             return {0,0,0};
 
         hit_record record;
+        thread_ray_count()++;
 
-        // interval starts with 0.001 to fix shadow acne.
+        // interval starts with 0, shadow acne is prevented where the scattered rays are created (hit_record::spawn_ray).
         /** Due to some small numerical errors, introduced by the finite precision of numbers,
          * sometimes the intersection point is not directly above the surface, but slightly below.
          * When this happens and a shadow ray is cast in the light direction, instead of intersecting no object at all
          * or some other object above the object's surface, the shadow ray intersects the surface from which it is cast.
          * In other words, we have a case of self-intersection, which means that a ray will find the nearest surface at t=0.00000001.
-         * The simplest hack to address this is just to ignore hits that are very close to the calculated intersection point.
+         * The simplest hack to address this is just to ignore hits that are very close to the calculated intersection point,
+         * e.g. with t > 0.001. A fixed distance does not scale with the size of the scene and breaks down with float precision,
+         * so instead the origin of every scattered ray is moved off the surface by the rounding error of the hit point.
  */
-        if (world.hit(in_ray, interval(0.001, infinity), record))
-        {
-            ray scattered;
-            color attenuation;
+        if (world.hit(in_ray, interval(0, infinity), record))
+            return hit_color(in_ray, record, depth, world, bounce_pdf);
 
-            if (record.hit_material->scatter(in_ray, record, attenuation, scattered))
-                // recursive function stops when depth (maximum number of ray bounces) equals 0.
-                return attenuation * define_ray_color(scattered, depth-1, world);
+        return background_color(in_ray, bounce_pdf);
+    }
 
-            return {0,0,0};
+    color hit_color(const ray& in_ray, const hit_record& record, int depth, const hittable& world,
+                    double bounce_pdf = 0) const
+    /** The light leaving the hit point towards the origin of the ray: the light the surface gives off itself,
+     * plus the light reflected from elsewhere, found by following the scattered ray further. */
+    {
+        color emission = record.front_face ? record.hit_material->emitted() : color(0,0,0);
+        if (bounce_pdf > 0 && lights && record.object)
+            // a diffuse bounce that hits a light shares it with the light sample taken at its origin (direct_light)
+            emission = power_heuristic(bounce_pdf, lights->pdf(in_ray.origin(), record.object, in_ray.direction())) * emission;
+
+        color albedo;
+        if ((guide || cache || environment || lights) && record.hit_material->diffuse_albedo(albedo))
+            return emission + albedo * diffuse_incoming(record, depth, world);
+
+        ray scattered;
+        color attenuation;
+
+        if (record.hit_material->scatter(in_ray, record, attenuation, scattered))
+            // recursive function stops when depth (maximum number of ray bounces) equals 0.
+            return emission + attenuation * define_ray_color(scattered, depth-1, world);
+
+        return emission;
+    }
+
+    color background_color(const ray& in_ray, double bounce_pdf = 0) const
+    /** The light of the sky seen along a ray that hits nothing. */
+    {
+        if (environment)
+        {
+            // a diffuse bounce that hits the environment shares the light with the environment sample taken at its origin
+            auto weight = bounce_pdf > 0 ? power_heuristic(bounce_pdf, environment->pdf(in_ray.direction())) : 1.0;
+            return weight * environment->lookup(in_ray.direction());
         }
+        if (!sky)
+            return {0,0,0}; // e.g. a night scene lit only by its own lights
 
         // implementation of a simple gradient
         vec3 unit_direction = unit_vector(in_ray.direction()); // normalizes ray vector
@@ -166,6 +543,120 @@ private:
         return (1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0);
     }
 
+    color diffuse_incoming(const hit_record& record, int depth, const hittable& world) const
+    /** The cosine-weighted incoming light at a diffuse surface point, which the Lambertian surface multiplies with its
+     * albedo. Deeper in the path it comes from the radiance cache if the cache knows the place; otherwise one bounce
+     * ray is traced, and its result is added to the cache for later paths. */
+    {
+        color incoming;
+        if (cache && max_depth - depth >= radiance_cache_after_bounces && cache->lookup(record.point, record.normal, incoming))
+            return incoming;
+
+        if (guide)
+            incoming = guided_incoming(record, depth, world);
+        else
+        {
+            auto direction = random_cosine_direction(record.normal);
+            auto pdf = (environment || lights) ? dot(direction, record.normal) / pi : 0.0;
+            incoming = define_ray_color(record.spawn_ray(direction), depth-1, world, pdf);
+        }
+        if (environment)
+            incoming += direct_environment_light(record, world);
+        if (lights)
+            incoming += direct_light(record, world);
+
+        if (cache)
+            cache->record(record.point, record.normal, incoming);
+        return incoming;
+    }
+
+    color guided_incoming(const hit_record& record, int depth, const hittable& world) const
+    /** Diffuse bounce with path guiding. The direction comes either from the learned distribution of the cell
+     * (with probability guiding_fraction) or from the cosine lobe of the Lambertian surface. This "one-sample MIS"
+     * weights the result by the combined density of both strategies, so the estimate stays unbiased even where the guide
+     * is poor, and the cosine lobe covers directions the guide has never seen light from. */
+    {
+        const guide_distribution* learned = guide->find(record.point);
+        bool use_guide = learned && random_double() < guiding_fraction;
+
+        vec3 direction = use_guide ? learned->sample(random_double(), random_double(), random_double())
+                                   : random_cosine_direction(record.normal);
+
+        auto cosine = dot(direction, record.normal);
+        if (cosine <= 0)
+            return {0,0,0}; // the guide can pick a direction below the surface, where a diffuse surface reflects nothing
+
+        // The Lambertian BRDF is albedo/pi, and its own sampling density is cos(theta)/pi.
+        auto bsdf_pdf = cosine / pi;
+        auto pdf = diffuse_bounce_pdf(record, direction);
+
+        color incoming = define_ray_color(record.spawn_ray(direction), depth-1, world, (environment || lights) ? pdf : 0.0);
+        if (guide_learning)
+            guide->record(record.point, direction, incoming, pdf);
+
+        // f * cos(theta) / pdf = albedo * (cos(theta)/pi) / pdf, the albedo is applied by the caller
+        return (bsdf_pdf / pdf) * incoming;
+    }
+
+    double diffuse_bounce_pdf(const hit_record& record, const vec3& direction) const
+    /** The density with which diffuse_incoming picks the bounce direction: the cosine lobe of the Lambertian surface,
+     * mixed with the learned distribution where path guiding knows the place. */
+    {
+        auto bsdf_pdf = std::fmax(0.0, dot(direction, record.normal)) / pi;
+        const guide_distribution* learned = guide ? guide->find(record.point) : nullptr;
+        return learned ? guiding_fraction * learned->pdf(direction) + (1 - guiding_fraction) * bsdf_pdf : bsdf_pdf;
+    }
+
+    color direct_environment_light(const hit_record& record, const hittable& world) const
+    /** Light of the environment map reaching a diffuse surface point directly, by sampling the bright parts of the map
+     * and tracing a shadow ray towards them. The bounce ray of the same point can hit the environment too;
+     * both samples are weighted with multiple importance sampling, so each counts most where its strategy is better:
+     * the map sample for a small sun, the bounce for large dim parts of the sky seen at a steep angle. */
+    {
+        double light_pdf;
+        vec3 direction = environment->sample(random_double(), random_double(), light_pdf);
+        auto cosine = dot(direction, record.normal);
+        if (light_pdf <= 0 || cosine <= 0)
+            return {0,0,0};
+
+        hit_record blocker;
+        thread_ray_count()++;
+        if (world.hit(record.spawn_ray(direction), interval(0, infinity), blocker))
+            return {0,0,0};
+
+        // f * cos(theta) / pdf without the albedo, which the caller applies
+        auto weight = power_heuristic(light_pdf, diffuse_bounce_pdf(record, direction));
+        return (weight * (cosine / pi) / light_pdf) * environment->lookup(direction);
+    }
+
+    color direct_light(const hit_record& record, const hittable& world) const
+    /** Light of the scene's emissive objects reaching a diffuse surface point directly. The light tree picks one light
+     * for the point, a direction towards it is sampled, and a shadow ray checks that nothing is in between.
+     * As with the environment, the bounce ray may hit the same light, and both samples are weighted with MIS. */
+    {
+        double pick_probability;
+        const hittable* light = lights->sample(record.point, random_double(), pick_probability);
+        if (!light)
+            return {0,0,0};
+
+        vec3 direction = light->random(record.point);
+        auto light_pdf = pick_probability * light->pdf_value(record.point, direction);
+        auto cosine = dot(direction, record.normal);
+        if (light_pdf <= 0 || cosine <= 0)
+            return {0,0,0};
+
+        // the light itself is found at exactly the distance where it was hit alone, which the open interval excludes
+        ray shadow_ray = record.spawn_ray(direction);
+        hit_record light_record, blocker;
+        thread_ray_count()++;
+        if (!light->hit(shadow_ray, interval(0, infinity), light_record) || !light_record.front_face
+            || world.hit(shadow_ray, interval(0, light_record.t), blocker))
+            return {0,0,0};
+
+        auto weight = power_heuristic(light_pdf, diffuse_bounce_pdf(record, direction));
+        return (weight * (cosine / pi) / light_pdf) * light_record.hit_material->emitted();
+    }
+
     ray generate_ray(int i, int j) const
     /** Constructs a camera ray originating from the defocus disk and directed at a randomly sampled point
      * around the pixel location i, j. */
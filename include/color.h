@@ -13,6 +13,12 @@ using color = vec3;
  * Gamma correction is typically the process of raising the color components to a power (often around 2.2 for encoding).
 */
 
+inline double luminance(const color& pixel_color)
+/** Brightness of a linear color as perceived by the eye (Rec. 709 weights): green counts most, blue least. */
+{
+    return 0.2126 * pixel_color.x() + 0.7152 * pixel_color.y() + 0.0722 * pixel_color.z();
+}
+
 inline double linear_to_gamma_corrected_value(double linear_component)
 /** The idea of gamma correction is to apply the inverse of the monitor's gamma to the final output color before displaying to the monitor.
  * We multiply each of the linear output colors by this inverse gamma curve (making them brighter)
@@ -27,8 +33,8 @@ inline double linear_to_gamma_corrected_value(double linear_component)
     return 0;
 }
 
-void write_color(std::ostream& out, const color& pixel_color)
-/** Writes a single pixel's color out to the standard output stream. */
+inline void color_to_bytes(const color& pixel_color, unsigned char* bytes)
+/** Converts a linear pixel color into three gamma corrected bytes in the [0, 255] range. */
 {
     auto red = pixel_color.x();
     auto green = pixel_color.y();
@@ -45,12 +51,19 @@ void write_color(std::ostream& out, const color& pixel_color)
     // After clamping, the [0,1) component values is scaled to the range [0, 255].
     // Casting a floating-point number to an integer in C++, the conversion is performed by truncating the decimal part.
     // This means the fractional part is discarded, and only the integer part is kept.
-    int red_byte = int(256 * intensity.clamp(red));
-    int green_byte = int(256 * intensity.clamp(green));
-    int blue_byte = int(256 * intensity.clamp(blue));
+    bytes[0] = static_cast<unsigned char>(256 * intensity.clamp(red));
+    bytes[1] = static_cast<unsigned char>(256 * intensity.clamp(green));
+    bytes[2] = static_cast<unsigned char>(256 * intensity.clamp(blue));
+}
+
+void write_color(std::ostream& out, const color& pixel_color)
+/** Writes a single pixel's color out to the standard output stream. */
+{
+    unsigned char bytes[3];
+    color_to_bytes(pixel_color, bytes);
 
     // Write out the pixel color components.
-    out << red_byte << ' ' << green_byte << ' ' << blue_byte << '\n';
+    out << int(bytes[0]) << ' ' << int(bytes[1]) << ' ' << int(bytes[2]) << '\n';
 }
 
 #endif //PROJECT_6_COLOR_H
@@ -5,12 +5,22 @@
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <cstdint>
 #include <cstdlib>
+#include <atomic>
 
 
 using std::make_shared;
 using std::shared_ptr;
 
+// Precision of the renderer: vectors, rays, intervals and all geometry use 'real'.
+// Define PROJECT_6_USE_FLOAT (CMake option of the same name) to render in float instead of double.
+#ifdef PROJECT_6_USE_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
+
 // Constants
 const double infinity = std::numeric_limits<double>::infinity();
 const double pi = 3.1415926535897932385;
@@ -21,10 +31,47 @@ inline double degrees_to_radians(double degrees)
     return degrees * pi / 180.0;
 }
 
+inline uint64_t mix_bits(uint64_t value)
+/** The finalizer of splitmix64: every input bit changes about half of the output bits,
+ * so neighbouring inputs (pixel 7 and pixel 8, seed 0 and seed 1) give unrelated outputs. */
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+inline uint64_t& random_state()
+/** The generator state of the calling thread.
+ * std::rand() shares one hidden state between all threads, so the render threads would fight over it.
+ * Every thread therefore owns its generator. Threads that never call seed_random are seeded in the order they first
+ * ask for a number, so the thread that builds the scene always draws the same sequence. */
+{
+    static std::atomic<unsigned> next_seed(0);
+    thread_local uint64_t state = mix_bits(next_seed++);
+    return state;
+}
+
+inline void seed_random(uint64_t seed)
+/** Restarts the calling thread's generator. The camera seeds it for every pixel sample (Camera::seed_sample), so
+ * the random numbers of a sample do not depend on which thread renders it or what that thread rendered before.
+ * Seeding is just storing the state, cheap enough to do millions of times per image. */
+{
+    random_state() = mix_bits(seed);
+}
+
+inline double random_double(uint64_t& state)
+/** Returns a random real in [0,1) and advances the given state: splitmix64, a 64-bit counter scrambled by mix_bits,
+ * whose top 53 bits become the mantissa of the double. A state of its own, started at mix_bits(seed), draws the same
+ * sequence as the thread's generator after seed_random(seed), without touching it. */
+{
+    state += 0x9e3779b97f4a7c15ULL;
+    return double(mix_bits(state) >> 11) * (1.0 / 9007199254740992.0); // 2^-53
+}
+
 inline double random_double()
-/** Returns a random real in [0,1). */
+/** Returns a random real in [0,1) from the generator of the calling thread. */
 {
-    return std::rand() / (RAND_MAX + 1.0);
+    return random_double(random_state());
 }
 
 inline double random_double(double min, double max)
@@ -36,6 +83,24 @@ inline double random_double(double min, double max)
     return min + (max-min)*random_double();
 }
 
+inline double power_heuristic(double pdf, double other_pdf)
+/** Weight of a sample taken with density pdf when another strategy could have taken it with other_pdf
+ * (multiple importance sampling, Veach's power heuristic with exponent 2). The weights of both strategies sum to one,
+ * and each strategy counts mostly where it is the better one. */
+{
+    auto squared = pdf * pdf;
+    auto other_squared = other_pdf * other_pdf;
+    return squared + other_squared > 0 ? squared / (squared + other_squared) : 0;
+}
+
+inline void atomic_add(std::atomic<float>& target, float value)
+/** Adds to a float shared between threads. C++14 has no fetch_add for floating point atomics,
+ * so the sum is retried until no other thread changed the value in between. */
+{
+    float expected = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed)) {}
+}
+
 // Common Headers
 #include "color.h"
 #include "interval.h"
@@ -0,0 +1,196 @@
+
+#ifndef PROJECT_6_ENVIRONMENT_MAP_H
+#define PROJECT_6_ENVIRONMENT_MAP_H
+
+#include "common.h"
+
+#include "hdr_image.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** An environment map is a photograph of the light arriving from every direction, e.g. an HDR panorama of a sky
+ * with the sun. Rays that leave the scene take their color from it instead of the sky gradient.
+ *
+ * The image is a latitude-longitude (equirectangular) panorama: u = 0..1 across the image goes once around the vertical
+ * axis, starting and ending behind -z, v = 0..1 down the image goes from straight up (+y) to straight down.
+ *
+ * Small bright parts like the sun carry most of the light but are rarely hit by directions chosen by the materials,
+ * which gives noisy images with fireflies. The map is therefore also a light that can be sampled: directions are chosen
+ * in proportion to the brightness of the pixels, with a 2D table of cumulative distributions built once when the map
+ * is loaded (the marginal over the rows, and a conditional one over the pixels of every row).
+ *
+ * The map is never changed after construction, so one instance is shared read-only by all render threads
+ * (shared_ptr<const environment_map>).
+ */
+class environment_map {
+public:
+    environment_map(const hdr_image& image, double intensity = 1.0)
+            : width(image.width), height(image.height), pixels(size_t(width) * height)
+    {
+        for (size_t p = 0; p < pixels.size(); p++)
+            pixels[p] = intensity * color(image.pixels[p*3], image.pixels[p*3 + 1], image.pixels[p*3 + 2]);
+        build_distribution();
+    }
+
+    color lookup(const vec3& direction) const
+    /** The light arriving from the direction, blended bilinearly between the four nearest pixels. */
+    {
+        double u, v;
+        direction_to_uv(unit_vector(direction), u, v);
+
+        // pixel centers are at half-integer coordinates
+        auto x = u * width - 0.5;
+        auto y = v * height - 0.5;
+        auto x0 = std::floor(x), y0 = std::floor(y);
+        auto fx = x - x0, fy = y - y0;
+
+        int column0 = wrap_column(int(x0)), column1 = wrap_column(int(x0) + 1);
+        int row0 = std::max(0, std::min(int(y0), height - 1)), row1 = std::max(0, std::min(int(y0) + 1, height - 1));
+
+        return (1-fy) * ((1-fx) * pixel(column0, row0) + fx * pixel(column1, row0))
+               +   fy * ((1-fx) * pixel(column0, row1) + fx * pixel(column1, row1));
+    }
+
+    vec3 sample(double u1, double u2, double& pdf) const
+    /** Picks a direction in proportion to the brightness of the map: a row with the marginal distribution (u1),
+     * a pixel in the row with its conditional distribution (u2), and a uniform point in the pixel. Returns the density
+     * of the direction per unit solid angle in pdf. */
+    {
+        double row_offset, column_offset;
+        int row = sample_cdf(marginal_cdf.data(), height, u1, row_offset);
+        int column = sample_cdf(&conditional_cdf[size_t(row) * width], width, u2, column_offset);
+
+        double u = (column + column_offset) / width;
+        double v = (row + row_offset) / height;
+        vec3 direction = uv_to_direction(u, v);
+        pdf = pdf_of(column, row, v);
+        return direction;
+    }
+
+    double pdf(const vec3& direction) const
+    /** The density with which sample() picks the direction, per unit solid angle. */
+    {
+        double u, v;
+        direction_to_uv(unit_vector(direction), u, v);
+        int column = std::min(int(u * width), width - 1);
+        int row = std::min(int(v * height), height - 1);
+        return pdf_of(column, row, v);
+    }
+
+private:
+    int width, height;
+    std::vector<color> pixels;
+    std::vector<double> marginal_cdf;     // height entries, the running sum of the row weights, normalized
+    std::vector<double> conditional_cdf;  // width entries per row, the running sum of the pixel weights, normalized
+    std::vector<double> probability;      // chance of every pixel to be picked
+
+    const color& pixel(int column, int row) const { return pixels[size_t(row) * width + column]; }
+
+    int wrap_column(int column) const { return ((column % width) + width) % width; }
+
+    static void direction_to_uv(const vec3& unit_direction, double& u, double& v)
+    {
+        u = 0.5 + std::atan2(unit_direction.x(), -unit_direction.z()) / (2*pi);
+        v = std::acos(std::max(-1.0, std::min(1.0, double(unit_direction.y())))) / pi;
+        u = std::min(std::max(u, 0.0), 1.0);
+    }
+
+    static vec3 uv_to_direction(double u, double v)
+    {
+        auto phi = (u - 0.5) * 2*pi;
+        auto theta = v * pi;
+        auto sin_theta = std::sin(theta);
+        return {sin_theta * std::sin(phi), std::cos(theta), -sin_theta * std::cos(phi)};
+    }
+
+    double pdf_of(int column, int row, double v) const
+    /** Pixels are picked with their probability and then sampled uniformly in u and v. The pixel covers 1/(width*height)
+     * of the (u, v) square, and a unit of (u, v) area covers 2 pi * pi * sin(theta) of solid angle. */
+    {
+        auto sin_theta = std::sin(v * pi);
+        if (sin_theta <= 0)
+            return 0;
+        return probability[size_t(row) * width + column] * width * height / (2*pi * pi * sin_theta);
+    }
+
+    void build_distribution()
+    /** Weighs every pixel by its brightness times sin(theta), since the rows near the poles cover less solid angle.
+     * A small share of the mean brightness is added everywhere, so dark pixels next to bright ones, which the bilinear
+     * lookup blends, can still be sampled. */
+    {
+        std::vector<double> weights(pixels.size());
+        double mean_luminance = 0;
+        for (const auto& p : pixels)
+            mean_luminance += luminance(p);
+        mean_luminance = mean_luminance / double(pixels.size()) + 1e-6;
+
+        for (int row = 0; row < height; row++)
+        {
+            auto sin_theta = std::sin((row + 0.5) / height * pi);
+            for (int column = 0; column < width; column++)
+                weights[size_t(row) * width + column] = (luminance(pixel(column, row)) + 0.01 * mean_luminance) * sin_theta;
+        }
+
+        marginal_cdf.assign(size_t(height), 0);
+        conditional_cdf.assign(pixels.size(), 0);
+        probability.assign(pixels.size(), 0);
+
+        double total = 0;
+        for (int row = 0; row < height; row++)
+        {
+            double row_sum = 0;
+            for (int column = 0; column < width; column++)
+            {
+                row_sum += weights[size_t(row) * width + column];
+                conditional_cdf[size_t(row) * width + column] = row_sum;
+            }
+            for (int column = 0; column < width; column++)
+                conditional_cdf[size_t(row) * width + column] /= row_sum;
+
+            total += row_sum;
+            marginal_cdf[size_t(row)] = total;
+        }
+        for (auto& cumulative : marginal_cdf)
+            cumulative /= total;
+        for (size_t p = 0; p < pixels.size(); p++)
+            probability[p] = weights[p] / total;
+    }
+
+    static int sample_cdf(const double* cdf, int count, double u, double& offset)
+    /** Finds the entry whose range of the cumulative distribution contains u, and the position of u within that range. */
+    {
+        int index = int(std::upper_bound(cdf, cdf + count, u) - cdf);
+        index = std::min(index, count - 1);
+        double start = index > 0 ? cdf[index - 1] : 0;
+        double range = cdf[index] - start;
+        offset = range > 0 ? std::min((u - start) / range, 1.0 - 1e-9) : 0.5;
+        return index;
+    }
+};
+
+inline shared_ptr<const environment_map> load_environment_map(const std::string& path, double intensity = 1.0)
+/** Loads the .hdr file into an environment map. A file already loaded (and still in use) with the same intensity is
+ * not read again; the existing map is shared, e.g. by several scenes of the render server. */
+{
+    static std::mutex loaded_mutex;
+    static std::map<std::pair<std::string, double>, std::weak_ptr<const environment_map>> loaded;
+
+    std::lock_guard<std::mutex> lock(loaded_mutex);
+    auto& entry = loaded[{path, intensity}];
+    if (auto existing = entry.lock())
+        return existing;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("cannot open environment map " + path);
+    auto map = make_shared<const environment_map>(read_hdr(file), intensity);
+    entry = map;
+    return map;
+}
+
+#endif //PROJECT_6_ENVIRONMENT_MAP_H
@@ -0,0 +1,101 @@
+
+#ifndef PROJECT_6_HDR_IMAGE_H
+#define PROJECT_6_HDR_IMAGE_H
+
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** A high dynamic range RGB image with float components, read from a Radiance .hdr (RGBE) file.
+ * HDR images store the actual amount of light, so a sun can be thousands of times brighter than the sky around it. */
+struct hdr_image {
+    int width = 0;
+    int height = 0;
+    std::vector<float> pixels;  // RGB triples, scanline by scanline from the top
+};
+
+inline hdr_image read_hdr(std::istream& in)
+/** Reads a Radiance .hdr file: a text header ending with an empty line, the resolution line "-Y <height> +X <width>",
+ * then the scanlines with four bytes per pixel, an 8-bit mantissa for R, G and B and a shared exponent E.
+ * Scanlines are either stored flat or run-length encoded channel by channel (the "new" RLE of Radiance). */
+{
+    std::string line;
+    std::getline(in, line);
+    if (line.compare(0, 2, "#?") != 0)
+        throw std::runtime_error("not a Radiance HDR image");
+    while (std::getline(in, line) && !line.empty())
+        if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+            throw std::runtime_error("unsupported HDR pixel format " + line.substr(7));
+
+    hdr_image image;
+    std::string y_axis, x_axis;
+    in >> y_axis >> image.height >> x_axis >> image.width;
+    in.get(); // the line break after the resolution
+    if (!in || y_axis != "-Y" || x_axis != "+X" || image.width <= 0 || image.height <= 0)
+        throw std::runtime_error("unsupported HDR image orientation or size");
+
+    image.pixels.resize(size_t(image.width) * image.height * 3);
+    std::vector<unsigned char> scanline(size_t(image.width) * 4);
+
+    for (int y = 0; y < image.height; y++)
+    {
+        unsigned char start[4];
+        in.read(reinterpret_cast<char*>(start), 4);
+        bool run_length_encoded = start[0] == 2 && start[1] == 2 && (start[2] << 8 | start[3]) == image.width
+                                  && image.width >= 8 && image.width < 32768;
+
+        if (!run_length_encoded)
+        {
+            std::copy(start, start + 4, scanline.begin());
+            in.read(reinterpret_cast<char*>(scanline.data() + 4), std::streamsize(scanline.size() - 4));
+        }
+        else
+        {
+            // the four channels follow each other; a count byte above 128 repeats the next byte count-128 times,
+            // otherwise that many bytes follow as they are
+            for (int channel = 0; channel < 4; channel++)
+            {
+                int x = 0;
+                while (x < image.width && in)
+                {
+                    int count = in.get();
+                    if (count > 128)
+                    {
+                        count -= 128;
+                        int value = in.get();
+                        if (x + count > image.width)
+                            throw std::runtime_error("HDR scanline run is too long");
+                        for (int run = 0; run < count; run++, x++)
+                            scanline[size_t(x) * 4 + channel] = static_cast<unsigned char>(value);
+                    }
+                    else
+                    {
+                        if (count == 0 || x + count > image.width)
+                            throw std::runtime_error("HDR scanline run is too long");
+                        for (int run = 0; run < count; run++, x++)
+                            scanline[size_t(x) * 4 + channel] = static_cast<unsigned char>(in.get());
+                    }
+                }
+            }
+        }
+
+        if (!in)
+            throw std::runtime_error("HDR image is truncated");
+
+        for (int x = 0; x < image.width; x++)
+        {
+            const unsigned char* rgbe = &scanline[size_t(x) * 4];
+            float* rgb = &image.pixels[(size_t(y) * image.width + x) * 3];
+            // the exponent is biased by 128, and the mantissas are fractions of 256; +0.5 takes the middle of the step
+            float scale = rgbe[3] == 0 ? 0.0f : float(std::ldexp(1.0, rgbe[3] - (128 + 8)));
+            for (int channel = 0; channel < 3; channel++)
+                rgb[channel] = rgbe[3] == 0 ? 0.0f : (rgbe[channel] + 0.5f) * scale;
+        }
+    }
+    return image;
+}
+
+#endif //PROJECT_6_HDR_IMAGE_H
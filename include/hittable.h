@@ -3,16 +3,21 @@
 #define PROJECT_6_HITTABLE_H
 
 #include "common.h"
+#include "aabb.h"
+#include "ray_packet.h"
 
+class hittable;
 class material;
 
 class hit_record {
 public:
     point3 point;
+    vec3 point_error;  // bound of the rounding error in each coordinate of point, see offset_ray_origin
     vec3 normal;
     shared_ptr<material> hit_material;
-    double t;
+    real t;
     bool front_face;
+    const hittable* object = nullptr; // the primitive that was hit, used to find the light it may be
 
 
     void set_face_normal(const ray& ray, const vec3& outward_normal)
@@ -26,6 +31,14 @@ public:
         front_face = dot(ray.direction(), outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
     }
+
+    ray spawn_ray(const vec3& direction) const
+    /** Creates a ray leaving the surface at the hit point. Its origin is pushed off the surface to the side the ray
+     * goes to (outside for reflection, inside for refraction), so it cannot hit the same surface right away. */
+    {
+        auto side_normal = dot(direction, normal) > 0 ? normal : -normal;
+        return {offset_ray_origin(point, point_error, side_normal), direction};
+    }
 };
 
 class hittable {
@@ -34,6 +47,44 @@ public:
 
     // the hit only “counts” if t(min)< t < t(max)
     virtual bool hit(const ray& ray, interval ray_t_interval, hit_record& record) const = 0;
+
+    // the box enclosing the whole object, used to build acceleration structures over the scene
+    virtual aabb bounding_box() const = 0;
+
+    // recomputes the cached bounds after objects inside have moved and returns the new box.
+    // Objects without inner structure already keep their box up to date.
+    virtual aabb refit() { return bounding_box(); }
+
+    // the light the object gives off in total (radiant power), black for objects that are not lights
+    virtual color emitted_power() const { return {0,0,0}; }
+
+    // density per unit solid angle with which random(origin) returns the direction, 0 if it never does
+    virtual double pdf_value(const point3& /*origin*/, const vec3& /*direction*/) const { return 0.0; }
+
+    // a random direction from the origin towards the object, for sampling the object as a light
+    virtual vec3 random(const point3& /*origin*/) const { return {1,0,0}; }
+
+    // finds the closest hits of all rays of the packet that are closer than their current ones.
+    // Objects without inner structure are skipped when no ray of the packet can reach their box, and tested ray by ray otherwise.
+    virtual void hit_packet(ray_packet& packet) const
+    {
+        if (!packet.may_hit(bounding_box()))
+            return;
+
+        hit_record record;
+        bool hit_any = false;
+        for (int k = 0; k < packet.count; k++)
+        {
+            if (hit(packet.rays[k], interval(0, packet.closest[k]), record))
+            {
+                packet.closest[k] = record.t;
+                packet.hit_object[k] = this;
+                hit_any = true;
+            }
+        }
+        if (hit_any)
+            packet.update_farthest();
+    }
 };
 
 
@@ -19,11 +19,16 @@ public:
     hittable_list() = default;
     explicit hittable_list(shared_ptr<hittable> object) { add(object); }
 
-    void clear() { objects.clear(); }
+    void clear()
+    {
+        objects.clear();
+        bbox = aabb();
+    }
 
     void add(shared_ptr<hittable> object)
     {
         objects.push_back(object);
+        bbox = aabb(bbox, object->bounding_box());
     }
 
     bool hit(const ray& ray, interval ray_t_interval, hit_record& record) const override
@@ -45,6 +50,25 @@ public:
 
         return hit_anything;
     }
+
+    void hit_packet(ray_packet& packet) const override
+    {
+        for (const auto& object : objects)
+            object->hit_packet(packet);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    aabb refit() override
+    {
+        bbox = aabb();
+        for (const auto& object : objects)
+            bbox = aabb(bbox, object->refit());
+        return bbox;
+    }
+
+private:
+    aabb bbox;
 };
 
 #endif //PROJECT_6_HITTABLE_LIST_H
@@ -3,33 +3,42 @@
 
 #include "common.h"
 
-class interval {
+/** Like vec3_t, the interval is templated on its scalar type; the renderer uses the 'interval' alias of precision 'real'. */
+template <typename T>
+class interval_t {
 public:
-    double min, max;
+    T min, max;
 
-    interval() : min(+infinity), max(-infinity) {} // Default interval is empty
+    interval_t() : min(+infinity), max(-infinity) {} // Default interval is empty
 
-    interval(double min, double max) : min(min), max(max) {}
+    interval_t(T min, T max) : min(min), max(max) {}
 
-    double size() const
+    interval_t(const interval_t& a, const interval_t& b)
+    /** Creates the interval tightly enclosing the two input intervals. */
+    {
+        min = a.min <= b.min ? a.min : b.min;
+        max = a.max >= b.max ? a.max : b.max;
+    }
+
+    T size() const
     /** Returns the size of the interval. */
     {
         return max - min;
     }
 
-    bool contains(double x) const
+    bool contains(T x) const
     /** Returns if the interval contains the variable including border values. */
     {
         return min <= x && x <= max;
     }
 
-    bool surrounds(double x) const
+    bool surrounds(T x) const
     /** Returns if the interval contains the variable excluding border values. */
     {
         return min < x && x < max;
     }
 
-    double clamp(double x) const
+    T clamp(T x) const
     /** Constrains a value within a specified range.*/
     {
         if (x < min) return min;
@@ -37,15 +46,24 @@ public:
         return x;
     }
 
+    interval_t expand(T delta) const
+    /** Pads the interval by the given amount, delta/2 on each side. */
+    {
+        auto padding = delta/2;
+        return interval_t(min - padding, max + padding);
+    }
+
     // By defining these constants statically, they can be accessed directly from the class
     // without needing to create instances of interval.
     // 'static const' ensures that all parts of the program use the same, consistent instances of these intervals.
-    static const interval empty, universe;
+    static const interval_t empty, universe;
 };
 
 // C++ requires that static members be defined outside the class to allocate storage for them.
-const interval interval::empty    = interval(+infinity, -infinity);
-const interval interval::universe = interval(-infinity, +infinity);
+template <typename T> const interval_t<T> interval_t<T>::empty    = interval_t<T>(+infinity, -infinity);
+template <typename T> const interval_t<T> interval_t<T>::universe = interval_t<T>(-infinity, +infinity);
+
+using interval = interval_t<real>;
 
 
 
@@ -0,0 +1,177 @@
+
+#ifndef PROJECT_6_LIGHT_TREE_H
+#define PROJECT_6_LIGHT_TREE_H
+
+#include "common.h"
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+/** A light tree (light BVH) picks one of many lights for a shading point, with a probability that follows how much
+ * light each is likely to send there. Picking uniformly wastes most samples on lights that are far away or dim,
+ * and testing every light costs L shadow rays per shading point.
+ *
+ * Like bvh_node, the tree is a binary hierarchy of bounding boxes, here over the lights only. Every node knows the total
+ * power of the lights below it. Its importance for a point is that power over the squared distance to the node, and
+ * sampling walks down from the root, choosing a child in proportion to its importance, so one pick costs O(log L).
+ * The distance is never taken smaller than half the node's diagonal: a point inside or close to a big node cannot
+ * tell where in the node the light is, and no light ever gets a zero probability.
+ *
+ * The tree is built once from the objects of the scene's hittable_list (before they are put into a BVH)
+ * and only read while rendering, so it is shared by all render threads.
+ */
+class light_tree {
+public:
+    explicit light_tree(const hittable_list& world)
+    /** Collects the objects giving off light and builds the tree over them. */
+    {
+        for (const auto& object : world.objects)
+            if (luminance(object->emitted_power()) > 0)
+                lights.push_back(object);
+        if (lights.empty())
+            return;
+
+        std::vector<int> order(lights.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = int(i);
+        nodes.reserve(2 * lights.size());
+        build(order, 0, order.size(), -1);
+    }
+
+    bool empty() const { return lights.empty(); }
+    size_t size() const { return lights.size(); }
+
+    const hittable* sample(const point3& point, double u, double& probability) const
+    /** Picks a light for the point and returns it with the probability of the pick. The one uniform number u is
+     * reused on every level: after a choice, the part of [0,1) that led to it is stretched back to [0,1). */
+    {
+        probability = 0;
+        if (nodes.empty())
+            return nullptr;
+
+        probability = 1;
+        int index = 0;
+        while (nodes[size_t(index)].light < 0)
+        {
+            const node& current = nodes[size_t(index)];
+            auto left_share = left_probability(current, point);
+            if (u < left_share)
+            {
+                u /= left_share;
+                probability *= left_share;
+                index = current.left;
+            }
+            else
+            {
+                u = (u - left_share) / (1 - left_share);
+                probability *= 1 - left_share;
+                index = current.right;
+            }
+            u = std::min(u, 1 - 1e-12); // rounding must not push u out of [0,1)
+        }
+        return lights[size_t(nodes[size_t(index)].light)].get();
+    }
+
+    double probability(const point3& point, const hittable* light) const
+    /** The probability that sample() picks the light for the point, 0 for objects that are not in the tree.
+     * Walks from the light's leaf up to the root, multiplying the choices on the way. */
+    {
+        auto found = leaf_of.find(light);
+        if (found == leaf_of.end())
+            return 0;
+
+        double result = 1;
+        int child = found->second;
+        for (int parent = nodes[size_t(child)].parent; parent >= 0; child = parent, parent = nodes[size_t(parent)].parent)
+        {
+            auto left_share = left_probability(nodes[size_t(parent)], point);
+            result *= nodes[size_t(parent)].left == child ? left_share : 1 - left_share;
+        }
+        return result;
+    }
+
+    double pdf(const point3& origin, const hittable* light, const vec3& direction) const
+    /** Density of the direction when a light is picked for the origin and then sampled: the pick probability times
+     * the light's own density of the direction. */
+    {
+        auto pick = probability(origin, light);
+        return pick > 0 ? pick * light->pdf_value(origin, direction) : 0.0;
+    }
+
+private:
+    struct node {
+        aabb bounds;
+        double power = 0;   // luminance of the total power of the lights below
+        int left = -1, right = -1;
+        int parent = -1;
+        int light = -1;     // index into lights for leaves, -1 for inner nodes
+    };
+
+    std::vector<shared_ptr<hittable>> lights;
+    std::vector<node> nodes;
+    std::unordered_map<const hittable*, int> leaf_of;
+
+    int build(std::vector<int>& order, size_t start, size_t end, int parent)
+    /** Builds the subtree over the lights order[start, end) like bvh_node: split in half along the longest axis. */
+    {
+        int index = int(nodes.size());
+        nodes.emplace_back();
+        nodes[size_t(index)].parent = parent;
+
+        if (end - start == 1)
+        {
+            const auto& light = lights[size_t(order[start])];
+            nodes[size_t(index)].bounds = light->bounding_box();
+            nodes[size_t(index)].power = luminance(light->emitted_power());
+            nodes[size_t(index)].light = order[start];
+            leaf_of[light.get()] = index;
+            return index;
+        }
+
+        aabb bounds = aabb::empty;
+        for (size_t i = start; i < end; i++)
+            bounds = aabb(bounds, lights[size_t(order[i])]->bounding_box());
+        int axis = bounds.longest_axis();
+
+        auto mid = start + (end - start)/2;
+        std::nth_element(order.begin() + long(start), order.begin() + long(mid), order.begin() + long(end),
+                         [this, axis](int a, int b) {
+                             return lights[size_t(a)]->bounding_box().axis_interval(axis).min
+                                    < lights[size_t(b)]->bounding_box().axis_interval(axis).min;
+                         });
+
+        int left = build(order, start, mid, index);
+        int right = build(order, mid, end, index);
+
+        // nodes may have grown and moved, so the node is looked up again after the recursion
+        node& current = nodes[size_t(index)];
+        current.left = left;
+        current.right = right;
+        current.bounds = aabb(nodes[size_t(left)].bounds, nodes[size_t(right)].bounds);
+        current.power = nodes[size_t(left)].power + nodes[size_t(right)].power;
+        return index;
+    }
+
+    double importance(const node& n, const point3& point) const
+    {
+        point3 center((n.bounds.x.min + n.bounds.x.max) / 2, (n.bounds.y.min + n.bounds.y.max) / 2,
+                      (n.bounds.z.min + n.bounds.z.max) / 2);
+        auto half_diagonal_squared = 0.25 * (vec3(n.bounds.x.size(), n.bounds.y.size(), n.bounds.z.size())).length_squared();
+        auto distance_squared = std::fmax((center - point).length_squared(), half_diagonal_squared);
+        return n.power / distance_squared;
+    }
+
+    double left_probability(const node& parent, const point3& point) const
+    {
+        auto left = importance(nodes[size_t(parent.left)], point);
+        auto right = importance(nodes[size_t(parent.right)], point);
+        return left + right > 0 ? left / (left + right) : 0.5;
+    }
+};
+
+#endif //PROJECT_6_LIGHT_TREE_H
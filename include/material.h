@@ -15,6 +15,19 @@ public:
     {
         return false;
     }
+
+    // Returns true and the albedo for ideal diffuse (Lambertian) materials. Their reflection is known in closed form,
+    // f = albedo / pi, so the camera can sample their bounces with its own strategies, e.g. path guiding.
+    virtual bool diffuse_albedo(color& /*albedo*/) const
+    {
+        return false;
+    }
+
+    // Returns the light the surface gives off by itself (radiance), black for everything except lights.
+    virtual color emitted() const
+    {
+        return {0,0,0};
+    }
 };
 
 /** Diffuse material
@@ -38,18 +51,21 @@ public:
 
     bool scatter(const ray& ray_in, const hit_record& record, color& attenuation, ray& scattered) const override
     {
-        // create Lambertian distribution by adding a random unit vector to the normal vector
-        auto scatter_direction = record.normal + random_unit_vector();
-        scattered = ray(record.point, scatter_direction);
-
-        // Catch degenerate scatter direction
-        if (scatter_direction.near_zero())
-            scatter_direction = record.normal;
+        // Lambertian distribution: scatter directions are cosine distributed around the normal.
+        // The sampled direction is never degenerate (zero), unlike normal + random_unit_vector().
+        auto scatter_direction = random_cosine_direction(record.normal);
+        scattered = record.spawn_ray(scatter_direction);
 
         attenuation = albedo;
         return true;
     }
 
+    bool diffuse_albedo(color& diffuse) const override
+    {
+        diffuse = albedo;
+        return true;
+    }
+
 private:
     color albedo; // albedo - Latin for “whiteness”
 };
@@ -69,7 +85,7 @@ public:
         // Fuzz sphere needs to be consistently scaled compared to the reflection vector, which requires to normalize reflected ray
         reflected = unit_vector(reflected) + (fuzz * random_unit_vector());
 
-        scattered = ray(rec.point, reflected);
+        scattered = rec.spawn_ray(reflected);
         attenuation = albedo;
         return (dot(scattered.direction(), rec.normal) > 0);
     }
@@ -114,7 +130,7 @@ public:
         else
             direction = refract(unit_direction, rec.normal, ri);
 
-        scattered = ray(rec.point, direction);
+        scattered = rec.spawn_ray(direction);
         return true;
     }
 
@@ -137,4 +153,18 @@ private:
     }
 };
 
+/** A light: the surface gives off the same light in every direction from its front side and reflects nothing. */
+class diffuse_light : public material {
+public:
+    explicit diffuse_light(const color& emit) : emit(emit) {}
+
+    color emitted() const override
+    {
+        return emit;
+    }
+
+private:
+    color emit;
+};
+
 #endif //PROJECT_6_MATERIAL_H
@@ -0,0 +1,143 @@
+
+#ifndef PROJECT_6_PATH_GUIDING_H
+#define PROJECT_6_PATH_GUIDING_H
+
+#include "common.h"
+
+#include "spatial_hash.h"
+
+#include <algorithm>
+#include <array>
+
+/** Path guiding learns where the light at a point of the scene comes from and sends more of the bounce rays there.
+ * A Lambertian surface samples directions by cos(theta) alone, so in a room lit through a small opening most rays hit
+ * dark walls and the image converges slowly. With guiding, early render passes record the radiance every bounce ray
+ * brings back; later passes sample directions proportionally to what was recorded.
+ *
+ * Space is divided into cells of a spatial hash (spatial_hash.h). Each cell keeps a histogram of incoming radiance
+ * over the sphere of directions, with bins of equal solid angle: the sphere is cut into slices of equal height in
+ * z = cos(theta), which have equal area (Archimedes' hat-box theorem), and every slice into equal angles phi.
+ *
+ * Learning and sampling use separate tables. Render threads add to the learned histograms with atomic operations
+ * and never touch the sampling tables, which are rebuilt by update() between passes while no thread renders.
+ */
+const int guide_z_bins = 8;
+const int guide_phi_bins = 16;
+const int guide_bin_count = guide_z_bins * guide_phi_bins;
+
+inline int guide_bin_of(const vec3& direction)
+/** Index of the direction bin: z = cos(theta) selects the slice, the angle phi around the z axis the bin in it. */
+{
+    auto unit = unit_vector(direction);
+    int z_bin = std::min(int((unit.z() + 1) / 2 * guide_z_bins), guide_z_bins - 1);
+    int phi_bin = std::min(int((std::atan2(unit.y(), unit.x()) + pi) / (2 * pi) * guide_phi_bins), guide_phi_bins - 1);
+    return std::max(z_bin, 0) * guide_phi_bins + std::max(phi_bin, 0);
+}
+
+/** A learned distribution of directions at one place of the scene. */
+class guide_distribution {
+public:
+    std::array<float, guide_bin_count> probability{};
+    std::array<float, guide_bin_count> cdf{};  // running sum of the probabilities, used to pick a bin
+
+    vec3 sample(double u1, double u2, double u3) const
+    /** Picks a bin proportionally to its probability (u1), then a uniform direction inside the bin (u2, u3). */
+    {
+        int bin = int(std::lower_bound(cdf.begin(), cdf.end(), float(u1)) - cdf.begin());
+        bin = std::min(bin, guide_bin_count - 1);
+
+        int z_bin = bin / guide_phi_bins;
+        int phi_bin = bin % guide_phi_bins;
+        auto z = -1 + 2 * (z_bin + u2) / guide_z_bins;
+        auto phi = 2 * pi * (phi_bin + u3) / guide_phi_bins - pi;
+        auto r = std::sqrt(std::fmax(0.0, 1 - z*z));
+        return {r * std::cos(phi), r * std::sin(phi), z};
+    }
+
+    double pdf(const vec3& direction) const
+    /** Probability density of the direction per unit solid angle: the bin probability over the bin's solid angle. */
+    {
+        return probability[guide_bin_of(direction)] / (4 * pi / guide_bin_count);
+    }
+};
+
+class path_guide {
+public:
+    explicit path_guide(double cell_size, int table_size = 1 << 14) : cell_size(cell_size), cells(size_t(table_size)) {}
+
+    void record(const point3& point, const vec3& direction, const color& radiance, double sample_pdf)
+    /** Adds the radiance that arrived at the point from the direction. Dividing by the probability of the sampled
+     * direction makes every bin an unbiased estimate of the radiance arriving through it, whichever strategy sampled it. */
+    {
+        auto value = luminance(radiance) / sample_pdf;
+        if (!(value > 0) || !std::isfinite(value))
+            return;
+
+        cell_type* cell = cells.claim(spatial_hash_key(point, cell_size));
+        if (!cell)
+            return; // every probed slot belongs to other cells, the sample is dropped
+
+        atomic_add(cell->learned[guide_bin_of(direction)], float(value));
+        cell->sample_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void update()
+    /** Rebuilds the sampling tables from everything learned so far. Must not run concurrently with rendering. */
+    {
+        cells.for_each([](cell_type& cell)
+        {
+            if (cell.sample_count.load() < minimum_samples)
+                return;
+
+            double total = 0;
+            for (const auto& bin : cell.learned)
+                total += bin.load();
+            if (total <= 0)
+                return;
+
+            // A share of the probability is spread uniformly, so directions that got no radiance in the few
+            // learning samples can still be chosen, and their pdf never becomes zero.
+            double cumulative = 0;
+            auto& sampling = cell.sampling;
+            for (int bin = 0; bin < guide_bin_count; bin++)
+            {
+                sampling.probability[bin] = float((1 - uniform_share) * cell.learned[bin].load() / total + uniform_share / guide_bin_count);
+                cumulative += sampling.probability[bin];
+                sampling.cdf[bin] = float(cumulative);
+            }
+            sampling.cdf[guide_bin_count - 1] = 1; // guards against rounding in the sum
+            cell.trained = true;
+        });
+    }
+
+    void clear(double new_cell_size)
+    /** Forgets everything learned, so the guide can learn another scene or view without allocating a new table. */
+    {
+        cell_size = new_cell_size;
+        cells.clear();
+    }
+
+    const guide_distribution* find(const point3& point) const
+    /** Returns the learned distribution at the point, or nullptr where too little was learned to guide. */
+    {
+        const cell_type* cell = cells.find(spatial_hash_key(point, cell_size));
+        return (cell && cell->trained) ? &cell->sampling : nullptr;
+    }
+
+private:
+    struct cell_type {
+        std::atomic<unsigned> sample_count{0};
+        std::array<std::atomic<float>, guide_bin_count> learned{}; // radiance sums, written by the render threads
+
+        bool trained = false;           // the sampling distribution is valid
+        guide_distribution sampling;
+    };
+
+    static const unsigned minimum_samples = 32; // cells with fewer samples keep plain BSDF sampling
+    static constexpr double uniform_share = 0.1;
+
+    double cell_size;
+    spatial_hash_table<cell_type> cells;
+};
+
+#endif //PROJECT_6_PATH_GUIDING_H
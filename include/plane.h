@@ -0,0 +1,52 @@
+
+#ifndef PROJECT_6_PLANE_H
+#define PROJECT_6_PLANE_H
+
+#include "hittable.h"
+
+/** An infinite plane through a point, facing the direction of its normal, e.g. the ground of an outdoor scene.
+ * Before, the ground was a sphere of radius 1000: every ray had to solve its quadratic, and its huge bounding box
+ * swallowed the boxes of everything else. A plane costs one dot product per ray.
+ *
+ * The plane has no finite bounding box. It must not be put into a bvh_node; two_level_scene keeps such objects
+ * in a separate list next to the hierarchy of the finite ones. */
+class plane : public hittable {
+public:
+    plane(const point3& point, const vec3& normal, shared_ptr<material> mat)
+            : point(point), normal(unit_vector(normal)), object_material(mat) {}
+
+    bool hit(const ray& ray, interval ray_t_interval, hit_record& record) const override
+    /** The points P of the plane satisfy (P - point) . normal = 0; on the ray P(t) = Q + td that gives
+     * t = (point - Q) . normal / (d . normal). A ray parallel to the plane (d . normal = 0) never hits it. */
+    {
+        auto denominator = dot(ray.direction(), normal);
+        if (denominator == 0)
+            return false;
+
+        auto root = dot(point - ray.origin(), normal) / denominator;
+        if (!ray_t_interval.surrounds(root))
+            return false;
+
+        record.t = root;
+        record.hit_material = object_material;
+        record.object = this;
+        // like the sphere, the hit point is put back onto the surface, here along the normal
+        auto hit_point = ray.at(root);
+        record.point = hit_point - dot(hit_point - point, normal) * normal;
+        const real error_scale = 8 * std::numeric_limits<real>::epsilon();
+        for (int axis = 0; axis < 3; axis++)
+            record.point_error[axis] = error_scale * (std::fabs(record.point[axis]) + std::fabs(point[axis]));
+        record.set_face_normal(ray, normal);
+
+        return true;
+    }
+
+    aabb bounding_box() const override { return aabb::universe; }
+
+private:
+    point3 point;
+    vec3 normal;
+    shared_ptr<material> object_material;
+};
+
+#endif //PROJECT_6_PLANE_H
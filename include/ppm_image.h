@@ -0,0 +1,64 @@
+
+#ifndef PROJECT_6_PPM_IMAGE_H
+#define PROJECT_6_PPM_IMAGE_H
+
+#include <cmath>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** An 8-bit RGB image read back from a PPM file, used to compare renders with each other. */
+struct ppm_image {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;  // RGB triples, scanline by scanline from the top
+};
+
+inline ppm_image read_ppm(std::istream& in)
+/** Reads both the text (P3) format of Camera::render and the binary (P6) format of Camera::render_tiled. */
+{
+    ppm_image image;
+    std::string format;
+    int max_value;
+    in >> format >> image.width >> image.height >> max_value;
+    if (!in || (format != "P3" && format != "P6") || max_value != 255)
+        throw std::runtime_error("not an 8-bit PPM image");
+
+    image.pixels.resize(size_t(image.width) * image.height * 3);
+    if (format == "P6")
+    {
+        in.get(); // the single whitespace character between the header and the pixel bytes
+        in.read(reinterpret_cast<char*>(image.pixels.data()), std::streamsize(image.pixels.size()));
+    }
+    else
+    {
+        for (auto& component : image.pixels)
+        {
+            int value;
+            in >> value;
+            component = static_cast<unsigned char>(value);
+        }
+    }
+
+    if (!in)
+        throw std::runtime_error("PPM image is truncated");
+    return image;
+}
+
+inline double image_rmse(const ppm_image& a, const ppm_image& b)
+/** Root mean square error between the color components of two images of the same size, in 0..255 units. */
+{
+    if (a.width != b.width || a.height != b.height)
+        throw std::runtime_error("images differ in size");
+
+    double squared_error_sum = 0;
+    for (size_t i = 0; i < a.pixels.size(); i++)
+    {
+        double difference = double(a.pixels[i]) - double(b.pixels[i]);
+        squared_error_sum += difference * difference;
+    }
+    return std::sqrt(squared_error_sum / double(a.pixels.size()));
+}
+
+#endif //PROJECT_6_PPM_IMAGE_H
@@ -0,0 +1,155 @@
+
+#ifndef PROJECT_6_PROGRESSIVE_PREVIEW_H
+#define PROJECT_6_PROGRESSIVE_PREVIEW_H
+
+#include "common.h"
+
+#include "camera.h"
+#include "hittable.h"
+#include "shared_frame.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** Interactive preview: renders the scene over and over, each frame better than the one before, and publishes every
+ * frame into a shared memory segment (shared_frame.h), where a viewer process picks it up.
+ *
+ * The first frames are small: 1/8, 1/4 and 1/2 of the image width at one sample per pixel, so something is on screen
+ * a few milliseconds after a change. Then the full image adds one sample per pixel per pass, and every pass publishes
+ * the average so far, until the camera's samples_per_pixel are reached.
+ *
+ * set_camera() may be called from any thread while run() renders. It cancels the pass in flight (render threads check
+ * between 8x8 pixel blocks) and restarts the refinement from the smallest frame with the new camera.
+ */
+class progressive_preview {
+public:
+    static const int first_scale = 8;  // the first frame has 1/first_scale of the image width
+
+    progressive_preview(const hittable& world, const Camera& camera, const std::string& segment_name)
+            : world(world), camera(camera),
+              frames(segment_name, camera.image_width, camera.rendered_height()),
+              context(camera.render_threads > 0 ? camera.render_threads : int(std::thread::hardware_concurrency()))
+    {
+        this->camera.show_progress = false;
+    }
+
+    Camera current_camera()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return camera;
+    }
+
+    void set_camera(const Camera& updated)
+    /** Replaces the camera and restarts the refinement. The image must fit into the shared memory segment. */
+    {
+        if (size_t(updated.image_width) * updated.rendered_height() > frames.max_pixels())
+            throw std::runtime_error("the preview image cannot grow beyond its size at the start");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            camera = updated;
+            camera.show_progress = false;
+            camera_version++;
+            changed_at = std::chrono::steady_clock::now();
+            restart = true;
+            cancel = true;
+        }
+        wake.notify_one();
+    }
+
+    void stop()
+    /** Makes run() return after cancelling the pass in flight. */
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            cancel = true;
+        }
+        wake.notify_one();
+    }
+
+    void run()
+    /** Renders and publishes frames until stop() is called. Waits for a camera change once the image is complete. */
+    {
+        Camera pass_camera;
+        uint64_t version = 0;
+        std::chrono::steady_clock::time_point version_start;
+        bool first_frame_of_version = true;
+        int scale = first_scale;
+        int passes = 0;        // full-size passes accumulated in sums
+        int target_samples = 0;
+
+        std::vector<color> sums;
+        std::vector<unsigned char> pixels;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || restart || passes < target_samples || target_samples == 0; });
+                if (stopping)
+                    return;
+                if (restart || target_samples == 0)
+                {
+                    pass_camera = camera;
+                    version = camera_version;
+                    version_start = changed_at;
+                    restart = false;
+                    cancel = false;
+
+                    first_frame_of_version = true;
+                    scale = first_scale;
+                    passes = 0;
+                    target_samples = std::max(1, camera.samples_per_pixel);
+                }
+            }
+
+            // the small frames are rendered from scratch, the full size accumulates passes of one sample per pixel
+            Camera frame_camera = pass_camera;
+            frame_camera.image_width = std::max(1, pass_camera.image_width / scale);
+            frame_camera.samples_per_pixel = 1;
+            if (scale > 1 || passes == 0)
+                sums.clear();
+
+            if (!frame_camera.render_pass(world, sums, scale > 1 ? 0 : passes, context, cancel))
+                continue; // a new camera, or stopping
+
+            int samples = scale > 1 ? 1 : ++passes;
+            int width = frame_camera.image_width;
+            int height = frame_camera.rendered_height();
+            pixels.resize(sums.size() * 3);
+            for (size_t p = 0; p < sums.size(); p++)
+                color_to_bytes(sums[p] / samples, &pixels[p * 3]);
+            frames.publish(width, height, samples, version, pixels.data());
+
+            if (first_frame_of_version && version > 0)
+            {
+                std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - version_start;
+                std::clog << "Camera change " << version << ": first frame after " << latency.count() << " ms\n";
+            }
+            first_frame_of_version = false;
+
+            if (scale > 1)
+                scale /= 2;
+        }
+    }
+
+private:
+    const hittable& world;
+    Camera camera;                  // the newest camera, guarded by mutex
+    uint64_t camera_version = 0;
+    std::chrono::steady_clock::time_point changed_at;
+    bool restart = false;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> cancel{false}; // read by the render threads between blocks, set together with restart or stopping
+
+    shared_frame_writer frames;
+    render_context context;
+};
+
+#endif //PROJECT_6_PROGRESSIVE_PREVIEW_H
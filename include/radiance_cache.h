@@ -0,0 +1,107 @@
+
+#ifndef PROJECT_6_RADIANCE_CACHE_H
+#define PROJECT_6_RADIANCE_CACHE_H
+
+#include "common.h"
+
+#include "spatial_hash.h"
+
+#include <algorithm>
+#include <array>
+
+/** A radiance cache remembers the light arriving at diffuse surfaces, so paths can stop early and use the remembered value
+ * instead of tracing the rest of the path. Diffuse indirect light changes slowly over a surface, so one average
+ * per small region of space is a good stand-in for it.
+ *
+ * Every diffuse hit adds the light its bounce ray brought back to the cell of a spatial hash (spatial_hash.h), keyed
+ * on the position and on the main direction of the surface normal, so the two sides of a thin object or the floor
+ * and a wall meeting in one cell are kept apart. What is stored is the cosine-weighted average of the incoming light,
+ * the value a Lambertian surface multiplies with its albedo; surfaces of different colors can therefore share a cell.
+ *
+ * Cells grow with the distance from the camera: a cell far away covers as few pixels as a near one, and the far parts
+ * of huge objects, which bounce rays hit all the time, do not flood the table with cells that are rarely used again.
+ * The edge length is the distance times a relative cell size, rounded down to a power of two, so every distance band
+ * has its own grid, told apart in the key.
+ *
+ * The cache makes the image biased: light is averaged over a whole cell. Smaller cells give less blur but need more
+ * samples before they can answer, so the relative cell size is the knob between bias and speed.
+ * Render threads add to the cells with atomic operations, and the cache fills while the image renders.
+ */
+class radiance_cache {
+public:
+    radiance_cache(double relative_cell_size, const point3& camera_center, int table_size = 1 << 18)
+            : relative_cell_size(relative_cell_size), camera_center(camera_center), cells(size_t(table_size)) {}
+
+    void record(const point3& point, const vec3& normal, const color& incoming)
+    /** Adds one estimate of the cosine-weighted incoming light at the surface point. */
+    {
+        if (!std::isfinite(incoming.x() + incoming.y() + incoming.z()))
+            return;
+
+        cell_type* cell = cells.claim(cell_key(point, normal));
+        if (!cell)
+            return; // every probed slot belongs to other cells, the sample is dropped
+
+        for (int channel = 0; channel < 3; channel++)
+            atomic_add(cell->sum[channel], float(incoming[channel]));
+        cell->sample_count.fetch_add(1, std::memory_order_release);
+    }
+
+    bool lookup(const point3& point, const vec3& normal, color& incoming) const
+    /** Returns true and the average incoming light of the cell once enough estimates were added to it. */
+    {
+        const cell_type* cell = cells.find(cell_key(point, normal));
+        if (!cell)
+            return false;
+
+        auto count = cell->sample_count.load(std::memory_order_acquire);
+        if (count < minimum_samples)
+            return false;
+
+        // Other threads may add between the loads; a sample more or less in the sums does not matter for an average of many.
+        incoming = color(cell->sum[0].load(std::memory_order_relaxed),
+                         cell->sum[1].load(std::memory_order_relaxed),
+                         cell->sum[2].load(std::memory_order_relaxed)) / double(count);
+        return true;
+    }
+
+    void clear(double new_relative_cell_size, const point3& new_camera_center)
+    /** Empties the cache for the next image, seen from the new camera center, without allocating a new table. */
+    {
+        relative_cell_size = new_relative_cell_size;
+        camera_center = new_camera_center;
+        cells.clear();
+    }
+
+private:
+    struct cell_type {
+        std::atomic<unsigned> sample_count{0};
+        std::array<std::atomic<float>, 3> sum{};
+    };
+
+    static const unsigned minimum_samples = 16; // cells answer only once their average is this well sampled
+
+    double relative_cell_size;
+    point3 camera_center;
+    spatial_hash_table<cell_type> cells;
+
+    std::uint64_t cell_key(const point3& point, const vec3& normal) const
+    /** Key of the cell of the point in the grid of its distance band, and of the main direction of the normal. */
+    {
+        auto size = relative_cell_size * (point - camera_center).length();
+        int level = std::max(-32, std::min(31, std::ilogb(std::fmax(size, 1e-9)))); // size rounded down to 2^level
+        auto band = std::uint64_t(level + 32);
+        return spatial_hash_key(point, std::ldexp(1.0, level), normal_class(normal) | band << 3);
+    }
+
+    static std::uint64_t normal_class(const vec3& normal)
+    /** One of six classes: the axis along which the normal points the most (x, y, z), and the sign along it. */
+    {
+        int axis = 0;
+        if (std::fabs(normal.y()) > std::fabs(normal[axis])) axis = 1;
+        if (std::fabs(normal.z()) > std::fabs(normal[axis])) axis = 2;
+        return std::uint64_t(axis * 2 + (normal[axis] < 0 ? 1 : 0));
+    }
+};
+
+#endif //PROJECT_6_RADIANCE_CACHE_H
@@ -16,24 +16,28 @@
  * b - the ray direction.
 */
 
-class ray{
+template <typename T>
+class ray_t{
 public:
-    ray() = default;
-    ray(const point3& origin, const vec3& direction) : ray_origin(origin), ray_direction(direction) {}
+    ray_t() = default;
+    ray_t(const vec3_t<T>& origin, const vec3_t<T>& direction) : ray_origin(origin), ray_direction(direction) {}
 
-    const point3& origin() const  { return ray_origin; }
-    const vec3& direction() const { return ray_direction; }
+    const vec3_t<T>& origin() const  { return ray_origin; }
+    const vec3_t<T>& direction() const { return ray_direction; }
 
-    point3 at(double t) const
+    vec3_t<T> at(T t) const
     /** Represents ray function P(t)=A+tb. */
     {
         return ray_origin + (t * ray_direction);
     }
 
 private:
-    point3 ray_origin;
-    vec3 ray_direction;
+    vec3_t<T> ray_origin;
+    vec3_t<T> ray_direction;
 };
 
+// the ray of the precision selected for the renderer
+using ray = ray_t<real>;
+
 
 #endif //PROJECT_6_RAY_H
@@ -0,0 +1,113 @@
+
+#ifndef PROJECT_6_RAY_PACKET_H
+#define PROJECT_6_RAY_PACKET_H
+
+#include "common.h"
+
+#include "aabb.h"
+
+#include <algorithm>
+
+class hittable;
+
+/** A packet of coherent rays traced through the scene together, e.g. the camera rays of a block of 8x8 pixels.
+ * Neighbouring camera rays start at (almost) the same point and point in almost the same direction, so they mostly
+ * hit and miss the same boxes. The packet keeps intervals enclosing the origins and the inverse directions of all its rays,
+ * and interval arithmetic then gives, with one test per box, bounds on where any ray of the packet can enter and leave it.
+ * When no ray can be inside the box, the whole node or object is skipped for all rays at once;
+ * otherwise the traversal goes on, and only the objects themselves are tested ray by ray.
+ *
+ * The packet records the closest hit of every ray as its distance and the object hit; the full hit record
+ * is computed afterwards for that one object only (hittable::hit_packet, Camera::render_tile).
+ */
+class ray_packet {
+public:
+    static const int max_rays = 64;
+
+    int count = 0;
+    ray rays[max_rays];
+    real closest[max_rays];             // distance of the closest hit so far, infinity while there is none
+    const hittable* hit_object[max_rays]; // object of the closest hit, nullptr while there is none
+
+    void clear() { count = 0; }
+
+    void add(const ray& r)
+    {
+        rays[count] = r;
+        closest[count] = infinity;
+        hit_object[count] = nullptr;
+        count++;
+    }
+
+    void prepare()
+    /** Computes the bounds of the origins and inverse directions once all rays are added, before tracing. */
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            origin[axis] = interval::empty;
+            inverse_direction[axis] = interval::empty;
+            for (int k = 0; k < count; k++)
+            {
+                origin[axis] = interval(origin[axis], interval(rays[k].origin()[axis], rays[k].origin()[axis]));
+                auto inverse = 1 / rays[k].direction()[axis];
+                inverse_direction[axis] = interval(inverse_direction[axis], interval(inverse, inverse));
+            }
+            // Directions crossing zero on the axis make the inverse unbounded; the axis then does not limit the packet.
+            same_sign[axis] = std::isfinite(inverse_direction[axis].min) && std::isfinite(inverse_direction[axis].max)
+                              && (inverse_direction[axis].min > 0 || inverse_direction[axis].max < 0);
+        }
+        update_farthest();
+    }
+
+    void update_farthest()
+    /** Recomputes the largest closest-hit distance, which boxes behind every found hit are culled against. */
+    {
+        farthest = 0;
+        for (int k = 0; k < count; k++)
+            farthest = std::max(farthest, closest[k]);
+    }
+
+    bool may_hit(const aabb& box) const
+    /** False if no ray of the packet can hit the box before its closest hit so far.
+     * For each axis, the distances at which the rays cross the two slab planes, (plane - origin) * inverse direction,
+     * are bounded by interval arithmetic. The rays miss the box for sure if the earliest possible entry through one slab
+     * comes after the latest possible exit through another, since then no ray is inside all slabs at once. */
+    {
+        real latest_entry = 0;
+        real earliest_exit = farthest;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (!same_sign[axis])
+                continue;
+
+            const interval& slab = box.axis_interval(axis);
+            auto to_min = interval(slab.min - origin[axis].max, slab.min - origin[axis].min);
+            auto to_max = interval(slab.max - origin[axis].max, slab.max - origin[axis].min);
+            auto t_min_plane = multiply(to_min, inverse_direction[axis]);
+            auto t_max_plane = multiply(to_max, inverse_direction[axis]);
+
+            // rays travelling in the negative direction enter through the max plane
+            const interval& entry = inverse_direction[axis].min > 0 ? t_min_plane : t_max_plane;
+            const interval& exit  = inverse_direction[axis].min > 0 ? t_max_plane : t_min_plane;
+            latest_entry = std::max(latest_entry, entry.min);
+            earliest_exit = std::min(earliest_exit, exit.max);
+        }
+        return latest_entry <= earliest_exit;
+    }
+
+private:
+    interval origin[3];
+    interval inverse_direction[3];
+    bool same_sign[3] = {false, false, false};
+    real farthest = infinity;
+
+    static interval multiply(const interval& a, const interval& b)
+    /** The interval of all products of a number from a and a number from b. */
+    {
+        real p1 = a.min * b.min, p2 = a.min * b.max, p3 = a.max * b.min, p4 = a.max * b.max;
+        return {std::min(std::min(p1, p2), std::min(p3, p4)), std::max(std::max(p1, p2), std::max(p3, p4))};
+    }
+};
+
+#endif //PROJECT_6_RAY_PACKET_H
@@ -0,0 +1,378 @@
+
+#ifndef PROJECT_6_RENDER_SERVER_H
+#define PROJECT_6_RENDER_SERVER_H
+
+#include "common.h"
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "scene_loader.h"
+#include "scenes.h"
+#include "thread_pool.h"
+#include "two_level_scene.h"
+#include "unix_socket.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+/** A long-running render process. Building a scene and its BVH happens once per 'load',
+ * after which any number of camera updates and renders reuse the resident scene.
+ *
+ * Clients connect to a local Unix socket and send one request per line:
+ *
+ *   load <scene> <file>|builtin:random_spheres   parse a scene file (see scene_loader.h) and build its BVH
+ *   camera <scene> <parameter> <values...> ...     change camera parameters of the scene
+ *   render <scene> <output.ppm>                    render the scene into a binary PPM file
+ *   scenes                                         list the resident scenes
+ *   shutdown                                       stop accepting requests and exit after the running jobs
+ *
+ * Every request is answered with a single line: "ok <milliseconds> [details]" or "error <milliseconds> <message>",
+ * where the milliseconds are the time the server spent on the request.
+ *
+ * One thread waits on all sockets at once (poll) and reads the requests; every complete request runs as a job on
+ * a pool of worker threads, so renders of different clients run concurrently, and an open but idle connection
+ * holds no worker. The requests of one connection are answered in order: while one of them runs, the connection
+ * is not read. A request line longer than 4096 bytes is answered with an error, and its
+ * connection is closed.
+ */
+class render_server {
+public:
+    render_server(std::string socket_path, int worker_count, int threads_per_job = 1)
+            : socket_path(std::move(socket_path)), worker_count(worker_count), threads_per_job(threads_per_job) {}
+
+    void run()
+    /** Serves connections until a client sends 'shutdown', then waits for the running jobs. Blocks the calling thread. */
+    {
+        listen_fd = listen_unix_socket(socket_path);
+        if (::pipe(wake_fds) < 0)
+        {
+            ::close(listen_fd);
+            throw std::runtime_error(std::string("cannot create pipe: ") + std::strerror(errno));
+        }
+        std::clog << "Render server listening at " << socket_path << " with " << worker_count << " workers, "
+                  << threads_per_job << " render threads per job\n";
+
+        std::map<int, connection> connections; // by socket, only touched by this thread
+        {
+            thread_pool workers(worker_count);
+            while (!stopping)
+            {
+                std::vector<pollfd> watched{{listen_fd, POLLIN, 0}, {wake_fds[0], POLLIN, 0}};
+                for (const auto& client : connections)
+                    if (!client.second.busy)
+                        watched.push_back({client.first, POLLIN, 0});
+                if (::poll(watched.data(), watched.size(), -1) < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    break;
+                }
+
+                if (watched[1].revents)
+                    collect_finished(connections);
+                if (watched[0].revents & POLLIN)
+                {
+                    int client_fd = ::accept(listen_fd, nullptr, nullptr);
+                    if (client_fd >= 0)
+                        connections[client_fd] = connection();
+                }
+                for (size_t w = 2; w < watched.size(); w++)
+                    if (watched[w].revents && !read_requests(watched[w].fd, connections[watched[w].fd]))
+                    {
+                        ::close(watched[w].fd); // the client closed the connection, it broke, or sent too long a line
+                        connections.erase(watched[w].fd);
+                    }
+
+                if (!stopping)
+                    for (auto& client : connections)
+                        start_next_request(client.first, client.second, workers);
+            }
+        } // the pool destructor waits for the jobs that are still running
+
+        for (const auto& client : connections)
+            ::close(client.first);
+        ::close(wake_fds[0]);
+        ::close(wake_fds[1]);
+        ::close(listen_fd);
+        ::unlink(socket_path.c_str());
+        std::clog << "Render server stopped\n";
+    }
+
+private:
+    /** Scene data kept between requests. The world is never modified after loading,
+     * so concurrent renders read it without locking; only the camera settings need a mutex. */
+    struct resident_scene {
+        shared_ptr<hittable> world;
+        Camera camera;
+        std::mutex camera_mutex;
+        size_t object_count = 0;
+    };
+
+    struct connection {
+        std::string received;  // bytes read but not yet taken as requests, may end with part of a line
+        bool busy = false;     // a request of the connection runs on the pool
+    };
+
+    static const size_t max_request_length = 4096; // bytes of one request line, far more than any request needs
+
+    std::string socket_path;
+    int worker_count;
+    int threads_per_job;      // Render threads used by every render job
+    int listen_fd = -1;
+    int wake_fds[2] = {-1, -1}; // jobs write a byte to wake_fds[1] to wake up the poll() in run()
+    std::atomic<bool> stopping{false};
+
+    std::mutex finished_mutex;
+    std::vector<std::pair<int, bool>> finished; // sockets whose request is done, and whether the reply was sent
+
+    std::map<std::string, shared_ptr<resident_scene>> scenes;
+    std::mutex scenes_mutex;
+
+    std::vector<std::unique_ptr<render_context>> spare_contexts; // contexts of finished renders, see borrow_context
+    std::mutex contexts_mutex;
+
+    static bool read_requests(int client_fd, connection& client)
+    /** Appends what the client sent to its buffer. Returns false if the connection was closed or broke, or if the next
+     * request is longer than max_request_length; that client is told so before the connection is closed. A connection
+     * is only read while it has no complete request waiting, so its buffer never grows much beyond the limit. */
+    {
+        char buffer[4096];
+        auto received = ::read(client_fd, buffer, sizeof(buffer));
+        if (received <= 0)
+            return false;
+        client.received.append(buffer, size_t(received));
+
+        if (std::min(client.received.find('\n'), client.received.size()) > max_request_length)
+        {
+            write_line(client_fd, "error 0 request too long");
+            return false;
+        }
+        return true;
+    }
+
+    void start_next_request(int client_fd, connection& client, thread_pool& workers)
+    /** Hands the next complete request of an idle connection to the pool. */
+    {
+        auto end_of_line = client.received.find('\n');
+        if (client.busy || end_of_line == std::string::npos)
+            return;
+
+        std::string request = client.received.substr(0, end_of_line);
+        client.received.erase(0, end_of_line + 1);
+        client.busy = true;
+        workers.submit([this, client_fd, request] {
+            bool sent = write_line(client_fd, answer(request));
+            {
+                std::lock_guard<std::mutex> lock(finished_mutex);
+                finished.emplace_back(client_fd, sent);
+            }
+            wake_up();
+        });
+    }
+
+    void wake_up()
+    /** Makes the poll() in run() return. */
+    {
+        char wake = 0;
+        if (::write(wake_fds[1], &wake, 1) < 0) {} // a full pipe wakes it up as well
+    }
+
+    void collect_finished(std::map<int, connection>& connections)
+    /** Makes the connections whose request is done idle again, so they are read and their next request can start. */
+    {
+        char drained[64];
+        if (::read(wake_fds[0], drained, sizeof(drained)) < 0) {} // bytes of several jobs at once, or none after EINTR
+
+        std::lock_guard<std::mutex> lock(finished_mutex);
+        for (const auto& done : finished)
+        {
+            if (done.second)
+                connections[done.first].busy = false;
+            else
+            {
+                ::close(done.first);
+                connections.erase(done.first);
+            }
+        }
+        finished.clear();
+    }
+
+    std::string answer(const std::string& request)
+    /** Executes one request and returns the response line. */
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::string status = "ok";
+        std::string details;
+
+        try {
+            details = handle(request);
+        }
+        catch (const std::exception& e) {
+            status = "error";
+            details = e.what();
+        }
+
+        std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - start;
+        std::ostringstream response;
+        response << status << ' ' << latency.count() << (details.empty() ? "" : " ") << details;
+
+        std::ostringstream log_line; // formatted first, so lines of concurrent requests don't interleave
+        log_line << "[" << latency.count() << " ms] " << request << " -> " << status << '\n';
+        std::clog << log_line.str();
+        return response.str();
+    }
+
+    std::string handle(const std::string& request)
+    /** Executes one request and returns the details for the response. Failures are thrown as exceptions. */
+    {
+        std::istringstream tokens(request);
+        std::string command, scene_name;
+        tokens >> command;
+
+        if (command == "load")
+        {
+            std::string source;
+            if (!(tokens >> scene_name >> source))
+                throw std::runtime_error("usage: load <scene> <file>|builtin:random_spheres");
+            return load(scene_name, source);
+        }
+        if (command == "camera")
+        {
+            tokens >> scene_name;
+            auto scene = find_scene(scene_name);
+            std::lock_guard<std::mutex> lock(scene->camera_mutex);
+
+            // the changes are applied to a copy, so a bad parameter leaves the camera untouched
+            Camera updated = scene->camera;
+            std::string parameter;
+            while (tokens >> parameter)
+                set_camera_parameter(updated, parameter, tokens);
+            scene->camera = updated;
+            return "";
+        }
+        if (command == "render")
+        {
+            std::string output_path;
+            if (!(tokens >> scene_name >> output_path))
+                throw std::runtime_error("usage: render <scene> <output.ppm>");
+            return render(scene_name, output_path);
+        }
+        if (command == "scenes")
+        {
+            std::lock_guard<std::mutex> lock(scenes_mutex);
+            std::string names;
+            for (const auto& scene : scenes)
+                names += (names.empty() ? "" : " ") + scene.first;
+            return names;
+        }
+        if (command == "shutdown")
+        {
+            // run() stops reading and accepting once it wakes up; the reply of this request is still sent
+            stopping = true;
+            wake_up();
+            return "";
+        }
+        throw std::runtime_error("unknown request '" + command + "'");
+    }
+
+    std::string load(const std::string& scene_name, const std::string& source)
+    /** Builds the scene and its BVH outside of any lock, then publishes it under the scene name. */
+    {
+        hittable_list objects;
+        auto scene = make_shared<resident_scene>();
+
+        if (source == "builtin:random_spheres")
+            random_spheres_scene(objects, scene->camera);
+        else
+        {
+            std::ifstream file(source);
+            if (!file)
+                throw std::runtime_error("cannot open " + source);
+            load_scene(file, objects, scene->camera);
+        }
+        if (objects.objects.empty())
+            throw std::runtime_error("scene " + source + " has no objects");
+
+        scene->object_count = objects.objects.size();
+        scene->world = make_shared<two_level_scene>(objects);
+
+        std::lock_guard<std::mutex> lock(scenes_mutex);
+        scenes[scene_name] = scene; // renders still running on a replaced scene keep their own reference to it
+        return std::to_string(scene->object_count) + " objects";
+    }
+
+    std::string render(const std::string& scene_name, const std::string& output_path)
+    {
+        auto scene = find_scene(scene_name);
+        Camera camera;
+        {
+            std::lock_guard<std::mutex> lock(scene->camera_mutex);
+            camera = scene->camera;
+        }
+        camera.render_threads = threads_per_job;
+        camera.show_progress = false; // progress of concurrent jobs would interleave in the server log
+
+        std::ofstream out(output_path, std::ios::binary);
+        if (!out)
+            throw std::runtime_error("cannot open " + output_path + " for writing");
+
+        auto context = borrow_context();
+        try {
+            camera.render_tiled(*scene->world, out, *context);
+        }
+        catch (...) {
+            return_context(std::move(context));
+            throw;
+        }
+        return_context(std::move(context));
+        return output_path;
+    }
+
+    std::unique_ptr<render_context> borrow_context()
+    /** A render context left by an earlier job, or a new one. No more contexts are made than jobs run at once, one per
+     * pool worker, and each keeps its threads, tile buffers and guide tables from render to render. */
+    {
+        {
+            std::lock_guard<std::mutex> lock(contexts_mutex);
+            if (!spare_contexts.empty())
+            {
+                auto context = std::move(spare_contexts.back());
+                spare_contexts.pop_back();
+                return context;
+            }
+        }
+        int thread_count = threads_per_job > 0 ? threads_per_job : int(std::thread::hardware_concurrency());
+        return std::unique_ptr<render_context>(new render_context(thread_count));
+    }
+
+    void return_context(std::unique_ptr<render_context> context)
+    {
+        std::lock_guard<std::mutex> lock(contexts_mutex);
+        spare_contexts.push_back(std::move(context));
+    }
+
+    shared_ptr<resident_scene> find_scene(const std::string& scene_name)
+    {
+        std::lock_guard<std::mutex> lock(scenes_mutex);
+        auto found = scenes.find(scene_name);
+        if (found == scenes.end())
+            throw std::runtime_error("no scene '" + scene_name + "' is loaded");
+        return found->second;
+    }
+};
+
+#endif //PROJECT_6_RENDER_SERVER_H
@@ -0,0 +1,197 @@
+
+#ifndef PROJECT_6_SCENE_LOADER_H
+#define PROJECT_6_SCENE_LOADER_H
+
+#include "common.h"
+
+#include "camera.h"
+#include "environment_map.h"
+#include "light_tree.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "plane.h"
+#include "sphere.h"
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/** Scenes can be described in a small line-based text format instead of being compiled into main.cpp.
+ * Every line starts with a keyword, '#' starts a comment:
+ *
+ *   material <name> lambertian <r> <g> <b>
+ *   material <name> metal <r> <g> <b> <fuzz>
+ *   material <name> dielectric <refraction_index>
+ *   material <name> light <r> <g> <b>   (emitted radiance, may be above 1)
+ *   sphere <x> <y> <z> <radius> <material name>
+ *   plane <x> <y> <z> <normal x> <normal y> <normal z> <material name>
+ *   camera <parameter> <values...>      (see set_camera_parameter, e.g. "camera path_guiding 1")
+ *   environment <file.hdr> [intensity]  (HDR panorama lighting the scene instead of the sky gradient, intensity > 0)
+ *
+ * Errors are reported with std::runtime_error carrying the line number.
+ */
+
+inline void set_camera_parameter(Camera& camera, const std::string& name, std::istream& values)
+/** Sets one named camera parameter from the values in the stream, e.g. "vfov 23" or "look_from 13 2 3".
+ * Values the renderer cannot work with, like a tile_size of 0, are rejected with std::runtime_error. */
+{
+    auto read_point = [&values]() {
+        double x, y, z;
+        values >> x >> y >> z;
+        return point3(x, y, z);
+    };
+
+    if      (name == "aspect_ratio")      values >> camera.aspect_ratio;
+    else if (name == "image_width")       values >> camera.image_width;
+    else if (name == "samples_per_pixel") values >> camera.samples_per_pixel;
+    else if (name == "max_depth")         values >> camera.max_depth;
+    else if (name == "vfov")              values >> camera.vfov;
+    else if (name == "look_from")         camera.look_from = read_point();
+    else if (name == "look_at")           camera.look_at = read_point();
+    else if (name == "view_up")           camera.view_up = read_point();
+    else if (name == "defocus_angle")     values >> camera.defocus_angle;
+    else if (name == "focus_dist")        values >> camera.focus_dist;
+    else if (name == "tile_size")         values >> camera.tile_size;
+    else if (name == "render_threads")    values >> camera.render_threads;
+    else if (name == "seed")              values >> camera.seed;
+    else if (name == "sky")               values >> camera.sky;
+    else if (name == "path_guiding")      values >> camera.path_guiding;
+    else if (name == "guiding_training_passes") values >> camera.guiding_training_passes;
+    else if (name == "guiding_fraction")  values >> camera.guiding_fraction;
+    else if (name == "guiding_cell_size") values >> camera.guiding_cell_size;
+    else if (name == "radiance_caching")  values >> camera.radiance_caching;
+    else if (name == "radiance_cache_after_bounces") values >> camera.radiance_cache_after_bounces;
+    else if (name == "radiance_cache_cell_size")     values >> camera.radiance_cache_cell_size;
+    else
+        throw std::runtime_error("unknown camera parameter '" + name + "'");
+
+    if (values.fail())
+        throw std::runtime_error("bad value for camera parameter '" + name + "'");
+
+    // the renderer divides by these or needs at least one of them, so 0 would crash it, e.g. a whole render server
+    bool positive = true;
+    if      (name == "aspect_ratio")      positive = camera.aspect_ratio > 0;
+    else if (name == "image_width")       positive = camera.image_width > 0;
+    else if (name == "samples_per_pixel") positive = camera.samples_per_pixel > 0;
+    else if (name == "max_depth")         positive = camera.max_depth > 0;
+    else if (name == "focus_dist")        positive = camera.focus_dist > 0;
+    else if (name == "tile_size")         positive = camera.tile_size > 0;
+    else if (name == "guiding_cell_size") positive = camera.guiding_cell_size > 0;
+    else if (name == "radiance_cache_cell_size") positive = camera.radiance_cache_cell_size > 0;
+    if (!positive)
+        throw std::runtime_error("camera parameter '" + name + "' must be positive");
+    if (name == "vfov" && !(camera.vfov > 0 && camera.vfov < 180))
+        throw std::runtime_error("camera parameter 'vfov' must be between 0 and 180 degrees");
+}
+
+inline void load_scene(std::istream& in, hittable_list& world, Camera& camera)
+/** Reads the scene description from the stream, adding its objects to world and its settings to camera.
+ * If the world then contains lights, the camera gets a light tree over them. */
+{
+    std::map<std::string, shared_ptr<material>> materials;
+    std::string line;
+    int line_number = 0;
+
+    while (std::getline(in, line))
+    {
+        line_number++;
+        auto error = [line_number](const std::string& message) {
+            return std::runtime_error("line " + std::to_string(line_number) + ": " + message);
+        };
+
+        std::istringstream tokens(line.substr(0, line.find('#')));
+        std::string keyword;
+        if (!(tokens >> keyword))
+            continue; // empty line or comment
+
+        if (keyword == "material")
+        {
+            std::string name, type;
+            tokens >> name >> type;
+            double r, g, b;
+
+            if (type == "lambertian" && tokens >> r >> g >> b)
+                materials[name] = make_shared<lambertian>(color(r, g, b));
+            else if (type == "metal" && tokens >> r >> g >> b)
+            {
+                double fuzz;
+                if (!(tokens >> fuzz))
+                    throw error("metal needs a fuzz value");
+                materials[name] = make_shared<metal>(color(r, g, b), fuzz);
+            }
+            else if (type == "dielectric" && tokens >> r)
+                materials[name] = make_shared<dielectric>(r);
+            else if (type == "light" && tokens >> r >> g >> b)
+                materials[name] = make_shared<diffuse_light>(color(r, g, b));
+            else
+                throw error("bad material '" + name + "'");
+        }
+        else if (keyword == "sphere")
+        {
+            double x, y, z, radius;
+            std::string material_name;
+            if (!(tokens >> x >> y >> z >> radius >> material_name))
+                throw error("sphere needs a center, a radius and a material");
+
+            auto found = materials.find(material_name);
+            if (found == materials.end())
+                throw error("unknown material '" + material_name + "'");
+            world.add(make_shared<sphere>(point3(x, y, z), radius, found->second));
+        }
+        else if (keyword == "plane")
+        {
+            double x, y, z, nx, ny, nz;
+            std::string material_name;
+            if (!(tokens >> x >> y >> z >> nx >> ny >> nz >> material_name))
+                throw error("plane needs a point, a normal and a material");
+
+            auto found = materials.find(material_name);
+            if (found == materials.end())
+                throw error("unknown material '" + material_name + "'");
+            world.add(make_shared<plane>(point3(x, y, z), vec3(nx, ny, nz), found->second));
+        }
+        else if (keyword == "camera")
+        {
+            std::string name;
+            tokens >> name;
+            try {
+                set_camera_parameter(camera, name, tokens);
+            }
+            catch (const std::runtime_error& camera_error) {
+                throw error(camera_error.what());
+            }
+        }
+        else if (keyword == "environment")
+        {
+            std::string path;
+            double intensity = 1;
+            if (!(tokens >> path))
+                throw error("environment needs an .hdr file");
+            std::string intensity_token;
+            if (tokens >> intensity_token)
+            {
+                std::istringstream number(intensity_token);
+                if (!(number >> intensity) || !number.eof())
+                    throw error("environment intensity '" + intensity_token + "' is not a number");
+                // a zero, negative or infinite scale leaves no usable weights for sampling the map, the image turns black
+                if (!(std::isfinite(intensity) && intensity > 0))
+                    throw error("environment intensity must be a positive number");
+            }
+            try {
+                camera.environment = load_environment_map(path, intensity);
+            }
+            catch (const std::runtime_error& load_error) {
+                throw error(load_error.what());
+            }
+        }
+        else
+            throw error("unknown keyword '" + keyword + "'");
+    }
+
+    auto scene_lights = make_shared<const light_tree>(world);
+    if (!scene_lights->empty())
+        camera.lights = scene_lights;
+}
+
+#endif //PROJECT_6_SCENE_LOADER_H
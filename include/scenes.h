@@ -0,0 +1,83 @@
+
+#ifndef PROJECT_6_SCENES_H
+#define PROJECT_6_SCENES_H
+
+#include "common.h"
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "plane.h"
+#include "sphere.h"
+
+inline void random_spheres_scene(hittable_list& world, Camera& camera, unsigned seed = 0)
+/** Builds the final scene of the book: a grid of small random spheres around three big ones, and sets up the camera for it.
+ * The same seed places the same spheres, whichever thread builds the scene. The layout is drawn from a generator of
+ * its own, so the random numbers of the calling thread are left as they were. */
+{
+    uint64_t state = mix_bits(seed);
+    auto random = [&state](double min, double max) { return min + (max-min)*random_double(state); };
+    auto random_color = [&random](double min, double max) {
+        auto r = random(min, max);
+        auto g = random(min, max);
+        auto b = random(min, max);
+        return color(r, g, b);
+    };
+    auto ground_material = make_shared<lambertian>(color(0.4, 0.6, 0.6));
+    world.add(make_shared<plane>(point3(0,0,0), vec3(0,1,0), ground_material));
+
+    for (int a = -6; a < 6; a++) {
+        for (int b = -6; b < 6; b++) {
+            // drawn one by one: the order of evaluation of function arguments is up to the compiler
+            auto choose_mat = random(0, 1);
+            auto x = a + 0.9*random(0, 1);
+            auto z = b + 0.9*random(0, 1);
+            point3 center(x, 0.2, z);
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
+                shared_ptr<material> sphere_material;
+
+                if (choose_mat < 0.7) {
+                    // diffuse
+                    auto albedo = random_color(0, 1);
+                    albedo = albedo * random_color(0, 1);
+                    sphere_material = make_shared<lambertian>(albedo);
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+                else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = random_color(0.5, 1);
+                    auto fuzz = random(0, 0.5);
+                    sphere_material = make_shared<metal>(albedo, fuzz);
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+                else {
+                    // glass
+                    sphere_material = make_shared<dielectric>(1.5);
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    auto material1 = make_shared<dielectric>(1.5);
+    world.add(make_shared<sphere>(point3(0, 1, 2), 1.0, material1));
+
+    auto material3 = make_shared<metal>(color(0.7, 0.5, 0.8), 0.1);
+    world.add(make_shared<sphere>(point3(4, 1.1, 0), 1.1, material3));
+
+    camera.aspect_ratio      = 16.0 / 9.0;
+    camera.image_width       = 1200;
+    camera.samples_per_pixel = 100;  // number of rays sent into area centered at the pixel and number of samples generated for each pixel
+    camera.max_depth         = 30;  // maximum number of rays bounces into scene
+
+    camera.vfov     = 23; //  field of view angle defines the size of the viewport. Increasing fov creates zoom in effect and vice versa.
+    camera.look_from = point3(13,2,3);
+    camera.look_at   = point3(0,0,0);
+    camera.view_up      = vec3(0,1,0);
+
+    camera.defocus_angle = 0.6;
+    camera.focus_dist    = 10.0;
+}
+
+#endif //PROJECT_6_SCENES_H
@@ -0,0 +1,237 @@
+
+#ifndef PROJECT_6_SHARED_FRAME_H
+#define PROJECT_6_SHARED_FRAME_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Frames of the interactive preview (progressive_preview.h) travel to viewer processes through a POSIX shared memory
+ * segment, named like "/project_6_preview". There is no socket and no copy through the kernel: the renderer writes
+ * the 8-bit RGB pixels into the segment and any number of readers copy them out.
+ *
+ * The segment holds two frame buffers. The renderer always writes the one that is not the newest frame (the back
+ * buffer) and then flips 'front' to it, so it never waits for a reader. Each buffer has a sequence number that is odd
+ * while the buffer is being written (a seqlock): a reader copies the front buffer and keeps the copy only if the
+ * sequence number was even and unchanged around the copy. That can only fail if the renderer published twice during
+ * one copy, in which case the reader simply copies the new front buffer.
+ *
+ * The frame timestamps are steady_clock nanoseconds, on Linux the system-wide CLOCK_MONOTONIC, so a reader can
+ * compare them with its own clock to tell how old a frame is.
+ */
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the shared frame segment needs lock-free 64-bit atomics");
+
+struct preview_frame {
+    uint64_t generation = 0;      // number of frames published before and including this one
+    uint64_t camera_version = 0;  // counts the camera changes; frames of one version refine the same view
+    int width = 0, height = 0;
+    int samples = 0;              // samples per pixel accumulated in the frame
+    int64_t publish_time = 0;     // steady_clock nanoseconds when the frame was published
+    std::vector<unsigned char> pixels; // width * height * 3 bytes, row by row from the top
+};
+
+namespace shared_frame_detail {
+
+const uint32_t magic = 0x50364652; // "P6FR", set once the segment is ready for readers
+
+struct buffer_header {
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> camera_version;
+    std::atomic<int32_t> width, height, samples;
+    std::atomic<int64_t> publish_time;
+};
+
+struct segment_header {
+    std::atomic<uint32_t> magic;
+    uint32_t max_pixels;                 // capacity of each buffer in pixels, fixed when the segment is created
+    std::atomic<uint32_t> front;         // index of the buffer with the newest complete frame
+    std::atomic<uint64_t> generation;    // frames published so far
+    buffer_header buffers[2];
+};
+
+inline size_t segment_size(uint32_t max_pixels)
+{
+    return sizeof(segment_header) + 2 * size_t(max_pixels) * 3;
+}
+
+inline unsigned char* buffer_pixels(segment_header* header, uint32_t buffer)
+{
+    return reinterpret_cast<unsigned char*>(header + 1) + buffer * size_t(header->max_pixels) * 3;
+}
+
+inline int64_t now_nanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace shared_frame_detail
+
+class shared_frame_writer {
+public:
+    shared_frame_writer(std::string name, int max_width, int max_height) : name(std::move(name))
+    /** Creates the segment for frames of up to max_width x max_height pixels, replacing a stale one of the same name. */
+    {
+        using namespace shared_frame_detail;
+        auto max_pixels = uint32_t(max_width) * uint32_t(max_height);
+
+        ::shm_unlink(this->name.c_str());
+        int fd = ::shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0)
+            throw std::runtime_error("cannot create shared memory " + this->name + ": " + std::strerror(errno));
+
+        size = segment_size(max_pixels);
+        void* memory = MAP_FAILED;
+        if (::ftruncate(fd, off_t(size)) == 0)
+            memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+        {
+            ::shm_unlink(this->name.c_str());
+            throw std::runtime_error("cannot map shared memory " + this->name + ": " + std::strerror(errno));
+        }
+
+        // the new segment is filled with zeros; the atomics only need their plain values set
+        header = static_cast<segment_header*>(memory);
+        header->max_pixels = max_pixels;
+        header->magic.store(magic, std::memory_order_release);
+    }
+
+    ~shared_frame_writer()
+    /** Removes the segment name; readers that still have it mapped keep their mapping. */
+    {
+        ::munmap(header, size);
+        ::shm_unlink(name.c_str());
+    }
+
+    shared_frame_writer(const shared_frame_writer&) = delete;
+    shared_frame_writer& operator=(const shared_frame_writer&) = delete;
+
+    size_t max_pixels() const { return header->max_pixels; }
+
+    void publish(int width, int height, int samples, uint64_t camera_version, const unsigned char* pixels)
+    /** Copies the frame into the back buffer and makes it the front buffer. Never blocks. Only one thread may publish. */
+    {
+        using namespace shared_frame_detail;
+        if (size_t(width) * height > header->max_pixels)
+            throw std::runtime_error("frame does not fit into the shared memory segment");
+
+        uint32_t back = 1 - header->front.load(std::memory_order_relaxed);
+        buffer_header& buffer = header->buffers[back];
+
+        auto sequence = buffer.sequence.load(std::memory_order_relaxed);
+        buffer.sequence.store(sequence + 1, std::memory_order_relaxed); // odd: readers must not trust the buffer
+        std::atomic_thread_fence(std::memory_order_release);
+
+        buffer.camera_version.store(camera_version, std::memory_order_relaxed);
+        buffer.width.store(width, std::memory_order_relaxed);
+        buffer.height.store(height, std::memory_order_relaxed);
+        buffer.samples.store(samples, std::memory_order_relaxed);
+        buffer.publish_time.store(now_nanoseconds(), std::memory_order_relaxed);
+        std::memcpy(buffer_pixels(header, back), pixels, size_t(width) * height * 3);
+
+        buffer.sequence.store(sequence + 2, std::memory_order_release);
+        header->front.store(back, std::memory_order_release);
+        header->generation.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    std::string name;
+    size_t size = 0;
+    shared_frame_detail::segment_header* header = nullptr;
+};
+
+class shared_frame_reader {
+public:
+    explicit shared_frame_reader(const std::string& name)
+    /** Maps the segment created by a shared_frame_writer of the same name. */
+    {
+        using namespace shared_frame_detail;
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            throw std::runtime_error("cannot open shared memory " + name + ": " + std::strerror(errno));
+
+        struct stat status{};
+        void* memory = MAP_FAILED;
+        if (::fstat(fd, &status) == 0 && size_t(status.st_size) >= sizeof(segment_header))
+        {
+            size = size_t(status.st_size);
+            memory = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (memory == MAP_FAILED)
+            throw std::runtime_error("cannot map shared memory " + name);
+
+        header = static_cast<segment_header*>(memory);
+        if (header->magic.load(std::memory_order_acquire) != magic || size < segment_size(header->max_pixels))
+        {
+            ::munmap(memory, size);
+            throw std::runtime_error(name + " is not a preview frame segment");
+        }
+    }
+
+    ~shared_frame_reader() { ::munmap(header, size); }
+
+    shared_frame_reader(const shared_frame_reader&) = delete;
+    shared_frame_reader& operator=(const shared_frame_reader&) = delete;
+
+    uint64_t generation() const { return header->generation.load(std::memory_order_acquire); }
+
+    bool read(preview_frame& frame) const
+    /** Copies the newest frame into 'frame' if it is newer than the frame already there. Never blocks the writer. */
+    {
+        using namespace shared_frame_detail;
+        while (true)
+        {
+            auto generation = header->generation.load(std::memory_order_acquire);
+            if (generation == 0 || generation == frame.generation)
+                return false;
+
+            uint32_t front = header->front.load(std::memory_order_acquire);
+            const buffer_header& buffer = header->buffers[front];
+            auto sequence = buffer.sequence.load(std::memory_order_acquire);
+            if (sequence % 2 == 1)
+                continue; // the writer went around and is overwriting this buffer already
+
+            frame.camera_version = buffer.camera_version.load(std::memory_order_relaxed);
+            frame.width = buffer.width.load(std::memory_order_relaxed);
+            frame.height = buffer.height.load(std::memory_order_relaxed);
+            frame.samples = buffer.samples.load(std::memory_order_relaxed);
+            frame.publish_time = buffer.publish_time.load(std::memory_order_relaxed);
+            auto bytes = size_t(frame.width) * size_t(frame.height) * 3;
+            if (bytes > size_t(header->max_pixels) * 3)
+                continue; // torn header, the sequence check below would fail as well
+            frame.pixels.resize(bytes);
+            std::memcpy(frame.pixels.data(), buffer_pixels(header, front), bytes);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (buffer.sequence.load(std::memory_order_relaxed) == sequence)
+            {
+                frame.generation = generation;
+                return true;
+            }
+        }
+    }
+
+    static double age_milliseconds(const preview_frame& frame)
+    /** Time since the frame was published. */
+    {
+        return double(shared_frame_detail::now_nanoseconds() - frame.publish_time) / 1e6;
+    }
+
+private:
+    size_t size = 0;
+    shared_frame_detail::segment_header* header = nullptr;
+};
+
+#endif //PROJECT_6_SHARED_FRAME_H
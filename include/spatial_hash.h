@@ -0,0 +1,111 @@
+
+#ifndef PROJECT_6_SPATIAL_HASH_H
+#define PROJECT_6_SPATIAL_HASH_H
+
+#include "common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/** A spatial hash divides space into a grid of cubic cells of a fixed size, but stores only the cells that are used.
+ * The integer coordinates of a cell are hashed into an index of a fixed-size table, so no bounds of the scene are needed
+ * and unbounded objects like the ground plane cost nothing. Different cells can land on the same index; the full key
+ * is stored with the data to tell them apart. */
+
+inline std::uint64_t spatial_hash_key(const point3& point, double cell_size, std::uint64_t extra = 0)
+/** Returns a non-zero key identifying the grid cell of the point; 'extra' adds up to 9 further bits, e.g. a normal direction.
+ * Coordinates keep 18 bits per axis, so cells 2^18 cells apart share a key; with the cell sizes used here that is far
+ * outside any scene. */
+{
+    auto cell_coordinate = [cell_size](double value) {
+        return std::uint64_t(std::int64_t(std::floor(value / cell_size))) & 0x3FFFF;
+    };
+    auto key = (cell_coordinate(point.x()) << 36) | (cell_coordinate(point.y()) << 18) | cell_coordinate(point.z());
+    return key | ((extra & 0x1FF) << 54) | (std::uint64_t(1) << 63); // the top bit keeps every key non-zero
+}
+
+inline std::uint64_t spatial_hash_index(std::uint64_t key, std::uint64_t table_size)
+/** Scrambles the key (the finalizer of MurmurHash3) so that neighbouring cells spread over the whole table. */
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key % table_size;
+}
+
+/** A fixed-size open-addressing table of the cells of a spatial hash, shared by the path guide and the radiance cache.
+ * Each slot holds the key of the cell owning it, 0 while free, and the cell's data. Render threads claim slots
+ * concurrently with a compare-and-swap on the key; a cell that finds all its probed slots taken by other cells is
+ * not stored, and its samples are dropped. The cell type must be default constructible; it is usually a few atomics. */
+template <typename Cell>
+class spatial_hash_table {
+public:
+    explicit spatial_hash_table(size_t size) : slots(size) {}
+
+    Cell* claim(std::uint64_t key)
+    /** Finds the slot of the cell, taking a free slot the first time the cell is seen. Returns nullptr if all probed
+     * slots belong to other cells. */
+    {
+        auto index = spatial_hash_index(key, slots.size());
+        for (int probe = 0; probe < probe_count; probe++)
+        {
+            auto& slot = slots[(index + probe) % slots.size()];
+            std::uint64_t expected = 0;
+            if (slot.key.compare_exchange_strong(expected, key) || expected == key)
+                return &slot.cell;
+        }
+        return nullptr;
+    }
+
+    const Cell* find(std::uint64_t key) const
+    /** Returns the cell of the key, or nullptr if it was never claimed. */
+    {
+        auto index = spatial_hash_index(key, slots.size());
+        for (int probe = 0; probe < probe_count; probe++)
+        {
+            const auto& slot = slots[(index + probe) % slots.size()];
+            if (slot.key.load(std::memory_order_relaxed) == key)
+                return &slot.cell;
+        }
+        return nullptr;
+    }
+
+    template <typename Function>
+    void for_each(Function function)
+    /** Calls the function with every claimed cell. Must not run concurrently with claim(). */
+    {
+        for (auto& slot : slots)
+            if (slot.key.load(std::memory_order_relaxed) != 0)
+                function(slot.cell);
+    }
+
+    void clear()
+    /** Frees all slots and resets their cells, keeping the memory: only the slots of claimed cells are touched.
+     * Must not run concurrently with claim() or find(). */
+    {
+        for (auto& slot : slots)
+        {
+            if (slot.key.load(std::memory_order_relaxed) == 0)
+                continue; // never claimed, still as constructed
+            slot.key.store(0, std::memory_order_relaxed);
+            slot.cell.~Cell();
+            new (&slot.cell) Cell();
+        }
+    }
+
+private:
+    struct slot_type {
+        std::atomic<std::uint64_t> key{0}; // spatial hash key of the cell owning the slot, 0 if free
+        Cell cell;
+    };
+
+    static const int probe_count = 4; // slots searched for a cell before giving up
+
+    std::vector<slot_type> slots;
+};
+
+#endif //PROJECT_6_SPATIAL_HASH_H
@@ -7,8 +7,12 @@
 
 class sphere : public hittable {
 public:
-    sphere(const point3& center, double radius, shared_ptr<material> mat)
-            : center(center), radius(std::fmax(0,radius)), object_material(mat) {}
+    sphere(const point3& center, real radius, shared_ptr<material> mat)
+            : center(center), radius(std::fmax(0,radius)), object_material(mat)
+    {
+        auto radius_vector = vec3(this->radius, this->radius, this->radius);
+        bbox = aabb(center - radius_vector, center + radius_vector);
+    }
 
 
     /** We want to know if our ray P(t)=Q+td ever hits the sphere anywhere.
@@ -27,38 +31,105 @@ public:
         // c = (C-Q)*(C-Q) - r^2
         auto c = oc.length_squared() - radius*radius;
 
-        auto discriminant = h*h - a*c;
+        // The textbook discriminant h*h - a*c subtracts two large, nearly equal numbers for big or distant spheres,
+        // and the difference loses most of its digits (catastrophic cancellation), especially in float.
+        // The equivalent form a*(r^2 - |(C-Q) - (h/a)d|^2) measures the distance from the center to the ray directly.
+        // (Haines et al., "Precision Improvements for Ray/Sphere Intersection", Ray Tracing Gems, 2019)
+        vec3 to_closest_point = oc - (h / a) * ray.direction();
+        auto discriminant = a * (radius*radius - to_closest_point.length_squared());
         if (discriminant < 0)
             return false;
 
         auto sqrtd = std::sqrt(discriminant);
 
+        // (h - sqrtd) / a cancels in the same way when h and sqrtd are close. The root with the sum is computed
+        // as usual and the other one follows from the product of the roots: t0 * t1 = c / a.
+        auto q = h + std::copysign(sqrtd, h);
+        // q = 0 only for a tangent ray (sqrtd = 0) whose closest point to the center is its origin (h = 0): the double
+        // root is t = 0, and c / q would be 0 / 0 = NaN
+        auto near_root = q == 0 ? q : std::fmin(q / a, c / q);
+        auto far_root = q == 0 ? q : std::fmax(q / a, c / q);
+
         // Find the nearest root that lies in the acceptable range.
-        auto root = (h - sqrtd) / a; // first possible root
+        auto root = near_root;
 
-        // check if the root falls into the interval from the closest (min = 0.001) point to the closest at the moment of hitting
+        // check if the root falls into the interval from the closest point to the closest at the moment of hitting
         // the maximum or closest value of the interval is updated in the hittable_list IF the ray hits any object.
         if (!ray_t_interval.surrounds(root))
         {
-            root = (h + sqrtd) / a;
+            root = far_root;
 
             if (!ray_t_interval.surrounds(root))
                 return false;
         }
 
         record.t = root; // the ray parameter t in ray function definition P(t)=Q+td
-        record.point = ray.at(root);
         record.hit_material = object_material;
-        vec3 outward_normal = (record.point - center) / radius; // unit length normal at the hit point
+        record.object = this;
+        vec3 outward_normal = unit_vector(ray.at(root) - center); // unit length normal at the hit point
+        // P(t) is off the surface by the rounding error of t; putting the point back onto the sphere along the normal
+        // keeps that error from reaching the rays spawned at the point
+        record.point = center + radius * outward_normal;
+        // each coordinate is a product and a sum, rounded a few times: its error is a few epsilons of the terms
+        const real error_scale = 8 * std::numeric_limits<real>::epsilon();
+        for (int axis = 0; axis < 3; axis++)
+            record.point_error[axis] = error_scale * (std::fabs(center[axis]) + std::fabs(radius * outward_normal[axis]));
         record.set_face_normal(ray, outward_normal); // define whether ray intersects from inside/outside the sphere and
 
         return true;
     }
 
+    aabb bounding_box() const override { return bbox; }
+
+    color emitted_power() const override
+    /** Radiance L leaving every point of the surface into the hemisphere carries pi * L per unit area. */
+    {
+        return (4*pi * radius*radius * pi) * object_material->emitted();
+    }
+
+    double pdf_value(const point3& origin, const vec3& direction) const override
+    /** random() samples the cone of directions from the origin that hit the sphere uniformly,
+     * so the density is one over the solid angle of the cone. */
+    {
+        hit_record record;
+        if (!hit(ray(origin, direction), interval(0, infinity), record))
+            return 0;
+
+        auto distance_squared = (center - origin).length_squared();
+        if (distance_squared <= radius*radius)
+            return 0; // the origin is inside, where random() cannot sample the sphere
+        auto cos_theta_max = std::sqrt(1 - radius*radius/distance_squared);
+        auto solid_angle = 2*pi*(1 - cos_theta_max);
+        return 1 / solid_angle;
+    }
+
+    vec3 random(const point3& origin) const override
+    /** A uniform direction in the cone from the origin around the sphere: seen from outside, a sphere is a disk
+     * of angular radius theta_max with sin(theta_max) = radius / distance. */
+    {
+        auto to_center = center - origin;
+        auto distance_squared = to_center.length_squared();
+        if (distance_squared <= radius*radius)
+            return random_unit_vector();
+        auto cos_theta_max = std::sqrt(1 - radius*radius/distance_squared);
+        return random_in_cone(unit_vector(to_center), cos_theta_max, random_double(), random_double());
+    }
+
+    void move_to(const point3& new_center)
+    /** Moves the sphere, e.g. between animation frames. Structures containing it have to be refitted afterwards. */
+    {
+        center = new_center;
+        auto radius_vector = vec3(radius, radius, radius);
+        bbox = aabb(center - radius_vector, center + radius_vector);
+    }
+
+    const point3& position() const { return center; }
+
 private:
     point3 center;
-    double radius;
+    real radius;
     shared_ptr<material> object_material;
+    aabb bbox;
 };
 
 
@@ -0,0 +1,95 @@
+
+#ifndef PROJECT_6_THREAD_POOL_H
+#define PROJECT_6_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** A fixed set of worker threads that execute submitted tasks in submission order.
+ * Creating a thread costs far more than handing a task to a waiting one, so long-running programs
+ * keep the workers alive and reuse them for every job. */
+class thread_pool {
+public:
+    explicit thread_pool(int thread_count)
+    {
+        if (thread_count < 1)
+            thread_count = 1;
+
+        for (int t = 0; t < thread_count; t++)
+            workers.emplace_back([this] { run_tasks(); });
+    }
+
+    ~thread_pool()
+    /** Finishes the tasks that are already queued and joins the workers. */
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        task_added.notify_all();
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    void submit(std::function<void()> task)
+    /** Queues the task for the first free worker. */
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        task_added.notify_one();
+    }
+
+    void wait_idle()
+    /** Blocks until every submitted task has finished. */
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        task_finished.wait(lock, [this] { return tasks.empty() && running_tasks == 0; });
+    }
+
+    int size() const { return int(workers.size()); }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_added;
+    std::condition_variable task_finished;
+    int running_tasks = 0;
+    bool stopping = false;
+
+    void run_tasks()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                task_added.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return; // stopping and nothing left to do
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+                running_tasks++;
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running_tasks--;
+            }
+            task_finished.notify_all();
+        }
+    }
+};
+
+#endif //PROJECT_6_THREAD_POOL_H
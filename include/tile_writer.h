@@ -0,0 +1,149 @@
+
+#ifndef PROJECT_6_TILE_WRITER_H
+#define PROJECT_6_TILE_WRITER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/** Tiled output splits the image into square tiles of tile_size x tile_size pixels.
+ * A horizontal strip of tiles is called a tile row: it covers tile_size scanlines of the full image width.
+ * Render threads pick tiles one by one in row-major order, so they all work on the same few tile rows at a time.
+ * As soon as every tile of the oldest tile row is done, the writer thread streams its scanlines to disk.
+ *
+ * Only 'capacity' tile rows exist in memory at any moment, so peak memory does not depend on the image height:
+ * capacity * tile_size * image_width * 3 bytes.
+ */
+
+class tile_row_queue {
+public:
+    tile_row_queue() = default;
+
+    tile_row_queue(int image_width, int image_height, int tile_size, int tiles_per_row, int capacity)
+    {
+        reset(image_width, image_height, tile_size, tiles_per_row, capacity);
+    }
+
+    void reset(int image_width, int image_height, int tile_size, int tiles_per_row, int capacity)
+    /** Prepares the queue for a new image. Buffers are allocated once and reused by every tile row that passes
+     * through the slot, and by following images of the same or smaller width. Must not be called while rendering. */
+    {
+        this->image_width = image_width;
+        this->image_height = image_height;
+        this->tile_size = tile_size;
+        this->tiles_per_row = tiles_per_row;
+        tile_row_count = (image_height + tile_size - 1) / tile_size;
+        next_to_write = 0;
+
+        slots.resize(capacity < 1 ? 1 : capacity);
+        for (auto& slot : slots)
+        {
+            slot.pixels.resize(size_t(tile_size) * image_width * 3);
+            slot.tile_row = -1;
+        }
+    }
+
+    unsigned char* acquire(int tile_row)
+    /** Returns the 8-bit RGB buffer of the tile row, blocking while the row is too far ahead of the writer.
+     * The first scanline of the tile row starts at the returned pointer; pixels are stored left to right. */
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        row_released.wait(lock, [&] { return tile_row < next_to_write + int(slots.size()); });
+
+        auto& slot = slot_of(tile_row);
+        // the first tile to arrive opens the tile row in its slot
+        if (slot.tile_row != tile_row)
+        {
+            slot.tile_row = tile_row;
+            slot.remaining_tiles = tiles_per_row;
+        }
+        return slot.pixels.data();
+    }
+
+    void complete_tile(int tile_row)
+    /** Marks one tile of the tile row as rendered. The last tile hands the whole row to the writer. */
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--slot_of(tile_row).remaining_tiles == 0)
+            row_ready.notify_all();
+    }
+
+    bool wait_next(const unsigned char*& pixels, int& rows)
+    /** Blocks until the next tile row in image order is complete.
+     * Returns false once every tile row of the image has been written. */
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (next_to_write == tile_row_count)
+            return false;
+
+        auto& slot = slot_of(next_to_write);
+        row_ready.wait(lock, [&] { return slot.tile_row == next_to_write && slot.remaining_tiles == 0; });
+
+        pixels = slot.pixels.data();
+        // the last tile row is shorter when the image height is not a multiple of the tile size
+        rows = std::min(tile_size, image_height - next_to_write * tile_size);
+        return true;
+    }
+
+    void release()
+    /** Called by the writer after the row returned by wait_next() is on disk; frees its slot for a new tile row. */
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot_of(next_to_write).tile_row = -1;
+        next_to_write++;
+        row_released.notify_all();
+    }
+
+    int rows_remaining() const
+    /** Number of tile rows that are not written yet. */
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return tile_row_count - next_to_write;
+    }
+
+private:
+    struct slot_type {
+        std::vector<unsigned char> pixels;
+        int tile_row = -1;        // tile row currently stored in the slot, -1 if the slot is free
+        int remaining_tiles = 0;  // tiles of the row that are still being rendered
+    };
+
+    int image_width = 0;
+    int image_height = 0;
+    int tile_size = 1;
+    int tiles_per_row = 0;
+    int tile_row_count = 0;
+    int next_to_write = 0;  // index of the oldest tile row that is not on disk yet
+
+    std::vector<slot_type> slots;
+    mutable std::mutex mutex;
+    std::condition_variable row_ready;     // a tile row has all of its tiles
+    std::condition_variable row_released;  // the writer freed a slot
+
+    slot_type& slot_of(int tile_row) { return slots[tile_row % slots.size()]; }
+};
+
+/** Binary PPM (P6) stores the header followed by raw RGB bytes scanline by scanline, top to bottom.
+ * Since nothing in the file refers forward, scanlines can be appended as soon as they are ready,
+ * and the file never has to be held in memory as a whole. */
+class ppm_stream_writer {
+public:
+    ppm_stream_writer(std::ostream& out, int image_width, int image_height) : out(out), image_width(image_width)
+    {
+        out << "P6\n" << image_width << ' ' << image_height << "\n255\n";
+    }
+
+    void write_rows(const unsigned char* pixels, int rows)
+    /** Appends 'rows' full scanlines of 8-bit RGB pixels. */
+    {
+        out.write(reinterpret_cast<const char*>(pixels), std::streamsize(rows) * image_width * 3);
+    }
+
+private:
+    std::ostream& out;
+    int image_width;
+};
+
+#endif //PROJECT_6_TILE_WRITER_H
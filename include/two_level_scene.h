@@ -0,0 +1,89 @@
+
+#ifndef PROJECT_6_TWO_LEVEL_SCENE_H
+#define PROJECT_6_TWO_LEVEL_SCENE_H
+
+#include "common.h"
+
+#include "bvh.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <vector>
+
+/** The top level of a scene: a BVH over the ordinary, finite objects, and next to it a short list of the objects
+ * that a hierarchy cannot hold well, i.e. unbounded ones like planes and huge ones like a ground sphere.
+ *
+ * A single huge box at the top of a BVH makes the root box, and every box on its way down, as large as the huge object,
+ * so every ray enters the tree and the split along the "longest axis" only separates the ground from everything else.
+ * Kept apart, the huge objects are simply tested for every ray, and the tree over the rest stays tight.
+ *
+ * An object counts as huge if its box is unbounded or its diagonal is more than huge_object_factor times
+ * the median diagonal of all objects.
+ */
+class two_level_scene : public hittable {
+public:
+    static constexpr double huge_object_factor = 50;
+
+    explicit two_level_scene(const hittable_list& world)
+    {
+        std::vector<double> diagonals;
+        for (const auto& object : world.objects)
+            diagonals.push_back(diagonal(object->bounding_box()));
+        std::sort(diagonals.begin(), diagonals.end());
+        double median = diagonals.empty() ? 0 : diagonals[(diagonals.size() - 1) / 2];
+
+        hittable_list finite;
+        for (const auto& object : world.objects)
+        {
+            auto size = diagonal(object->bounding_box());
+            if (!std::isfinite(size) || size > huge_object_factor * median)
+                huge.add(object);
+            else
+                finite.add(object);
+        }
+
+        if (!finite.objects.empty())
+            hierarchy = make_shared<bvh_node>(finite);
+        bbox = hierarchy ? aabb(hierarchy->bounding_box(), huge.bounding_box()) : huge.bounding_box();
+    }
+
+    bool hit(const ray& ray, interval ray_t_interval, hit_record& record) const override
+    /** The huge objects are tested first: the ground is hit by most rays, and its hit shortens the search in the tree. */
+    {
+        bool hit_anything = huge.hit(ray, ray_t_interval, record);
+        if (hierarchy && hierarchy->hit(ray, interval(ray_t_interval.min, hit_anything ? record.t : ray_t_interval.max), record))
+            hit_anything = true;
+        return hit_anything;
+    }
+
+    void hit_packet(ray_packet& packet) const override
+    {
+        huge.hit_packet(packet);
+        if (hierarchy)
+            hierarchy->hit_packet(packet);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    aabb refit() override
+    {
+        auto huge_box = huge.refit();
+        bbox = hierarchy ? aabb(hierarchy->refit(), huge_box) : huge_box;
+        return bbox;
+    }
+
+    size_t huge_object_count() const { return huge.objects.size(); }
+
+private:
+    hittable_list huge;               // unbounded and huge objects, tested by every ray
+    shared_ptr<bvh_node> hierarchy;   // all other objects, nullptr if there are none
+    aabb bbox;
+
+    static double diagonal(const aabb& box)
+    {
+        return vec3(box.x.size(), box.y.size(), box.z.size()).length();
+    }
+};
+
+#endif //PROJECT_6_TWO_LEVEL_SCENE_H
@@ -0,0 +1,93 @@
+
+#ifndef PROJECT_6_UNIX_SOCKET_H
+#define PROJECT_6_UNIX_SOCKET_H
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/** Helpers for the line-based protocol spoken by the render server and its client over a local Unix socket.
+ * A Unix domain socket is addressed by a path in the file system and never leaves the machine,
+ * so there is no need for network setup or authentication. Every message is a single line ending with '\n'. */
+
+inline sockaddr_un unix_socket_address(const std::string& path)
+{
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("socket path is too long: " + path);
+
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+inline int listen_unix_socket(const std::string& path)
+/** Creates a socket listening at the path, replacing a stale socket file left by a previous server. */
+{
+    auto address = unix_socket_address(path);
+    int socket_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_fd < 0)
+        throw std::runtime_error("cannot create socket");
+
+    ::unlink(path.c_str());
+    if (::bind(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(socket_fd, 64) < 0)
+    {
+        ::close(socket_fd);
+        throw std::runtime_error("cannot listen at " + path + ": " + std::strerror(errno));
+    }
+    return socket_fd;
+}
+
+inline int connect_unix_socket(const std::string& path)
+{
+    auto address = unix_socket_address(path);
+    int socket_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_fd < 0)
+        throw std::runtime_error("cannot create socket");
+
+    if (::connect(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        ::close(socket_fd);
+        throw std::runtime_error("cannot connect to " + path + ": " + std::strerror(errno));
+    }
+    return socket_fd;
+}
+
+inline bool read_line(int socket_fd, std::string& line)
+/** Reads bytes up to the next '\n' (not included in the line). Returns false if the peer closed the connection first. */
+{
+    line.clear();
+    char c;
+    while (true)
+    {
+        auto received = ::read(socket_fd, &c, 1);
+        if (received <= 0)
+            return false;
+        if (c == '\n')
+            return true;
+        line += c;
+    }
+}
+
+inline bool write_line(int socket_fd, const std::string& line)
+/** Sends the line followed by '\n'. Returns false if the connection is broken. */
+{
+    std::string message = line + '\n';
+    size_t sent = 0;
+    while (sent < message.size())
+    {
+        // MSG_NOSIGNAL: a peer that went away must not kill the whole process with SIGPIPE
+        auto written = ::send(socket_fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0)
+            return false;
+        sent += size_t(written);
+    }
+    return true;
+}
+
+#endif //PROJECT_6_UNIX_SOCKET_H
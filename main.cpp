@@ -4,70 +4,132 @@
 #include "include/common.h"
 
 
+#include "include/animation.h"
+#include "include/bvh.h"
 #include "include/camera.h"
 #include "include/hittable.h"
 #include "include/hittable_list.h"
 #include "include/material.h"
+#include "include/progressive_preview.h"
+#include "include/render_server.h"
+#include "include/scene_loader.h"
+#include "include/scenes.h"
 #include "include/sphere.h"
+#include "include/two_level_scene.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+
+int main(int argc, char* argv[]){
+    // project_6 --server [socket path] [worker count] [render threads per job] keeps scenes resident and renders
+    // requests of project_6_client
+    if (argc >= 2 && std::strcmp(argv[1], "--server") == 0)
+    {
+        std::string socket_path = argc >= 3 ? argv[2] : "/tmp/project_6.sock";
+        int worker_count = argc >= 4 ? std::atoi(argv[3]) : int(std::thread::hardware_concurrency());
+        int threads_per_job = argc >= 5 ? std::atoi(argv[4]) : 1;
+
+        try {
+            render_server server(socket_path, worker_count, threads_per_job);
+            server.run();
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
 
-
-int main(){
     hittable_list world;
+    Camera camera;
+    random_spheres_scene(world, camera);
+
+    // the --animate mode adds a glass ball rolling through the scene; it goes into the BVH, which refits as it moves
+    bool animate = argc == 4 && std::strcmp(argv[1], "--animate") == 0;
+    shared_ptr<sphere> rolling_sphere;
+    if (animate)
+    {
+        rolling_sphere = make_shared<sphere>(point3(-4, 0.5, 3), 0.5, make_shared<dielectric>(1.5));
+        world.add(rolling_sphere);
+    }
 
-    auto ground_material = make_shared<lambertian>(color(0.4, 0.6, 0.6));
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
-
-    for (int a = -6; a < 6; a++) {
-        for (int b = -6; b < 6; b++) {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
-
-            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.7) {
-                    // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+    // the BVH replaces the linear search over all objects with a search down a tree of bounding boxes;
+    // the ground plane stays outside of it, next to the tree
+    world = hittable_list(make_shared<two_level_scene>(world));
+
+    // project_6 --tiled <file.ppm> streams a binary PPM to the file tile row by tile row on all hardware threads,
+    // without arguments the plain text PPM is written to the standard output.
+    if (argc == 3 && std::strcmp(argv[1], "--tiled") == 0)
+    {
+        std::ofstream out(argv[2], std::ios::binary);
+        if (!out)
+        {
+            std::cerr << "Cannot open " << argv[2] << " for writing\n";
+            return 1;
+        }
+        camera.render_tiled(world, out);
+    }
+    // project_6 --preview [segment name] renders progressively into shared memory for project_6_preview_client;
+    // every line of the standard input changes the camera, e.g. "look_from 13 2 5 vfov 30", until "quit"
+    else if (argc >= 2 && std::strcmp(argv[1], "--preview") == 0)
+    {
+        try {
+            progressive_preview preview(world, camera, argc >= 3 ? argv[2] : "/project_6_preview");
+            std::thread renderer([&preview] { preview.run(); });
+
+            std::string line;
+            while (std::getline(std::cin, line) && line != "quit")
+            {
+                std::istringstream tokens(line);
+                Camera updated = preview.current_camera();
+                std::string parameter;
+                try {
+                    while (tokens >> parameter)
+                        set_camera_parameter(updated, parameter, tokens);
+                    preview.set_camera(updated);
                 }
-                else {
-                    // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                catch (const std::exception& e) {
+                    std::cerr << e.what() << '\n';
                 }
             }
+            preview.stop();
+            renderer.join();
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
         }
     }
+    // project_6 --animate <frame count> <output prefix> renders a turntable of the scene at 24 frames per second
+    // into <output prefix>0000.ppm, <output prefix>0001.ppm, ...
+    else if (animate)
+    {
+        int frame_count = std::atoi(argv[2]);
+        double frames_per_second = 24;
+        double duration = frame_count / frames_per_second;
+
+        animation turntable;
+        // the camera circles around the scene center; keyframes every 15 degrees keep the linear blending close to the circle
+        auto orbit_radius = std::sqrt(13.0*13.0 + 3.0*3.0);
+        for (int key = 0; key <= 24; key++)
+        {
+            auto angle = std::atan2(3.0, 13.0) + key * 2 * pi / 24;
+            turntable.look_from.add(duration * key / 24, point3(orbit_radius * std::cos(angle), 2, orbit_radius * std::sin(angle)));
+        }
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 2), 1.0, material1));
-
-    auto material3 = make_shared<metal>(color(0.7, 0.5, 0.8), 0.1);
-    world.add(make_shared<sphere>(point3(4, 1.1, 0), 1.1, material3));
-
-    Camera camera;
-
-    camera.aspect_ratio      = 16.0 / 9.0;
-    camera.image_width       = 1200;
-    camera.samples_per_pixel = 100;  // number of rays sent into area centered at the pixel and number of samples generated for each pixel
-    camera.max_depth         = 30;  // maximum number of rays bounces into scene
-
-    camera.vfov     = 23; //  field of view angle defines the size of the viewport. Increasing fov creates zoom in effect and vice versa.
-    camera.look_from = point3(13,2,3);
-    camera.look_at   = point3(0,0,0);
-    camera.view_up      = vec3(0,1,0);
+        keyframe_track<point3> rolling_path;
+        rolling_path.add(0, point3(-4, 0.5, 3));
+        rolling_path.add(duration, point3(4, 0.5, -3));
+        turntable.add_motion(rolling_sphere, rolling_path);
 
-    camera.defocus_angle = 0.6;
-    camera.focus_dist    = 10.0;
-    camera.render(world);
+        turntable.render(camera, world, frame_count, frames_per_second, argv[3]);
+    }
+    else
+        camera.render(world);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,87 @@
+#include "include/shared_frame.h"
+#include "include/tile_writer.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+/** Viewer of the interactive preview (project_6 --preview), without a window.
+ *
+ *   project_6_preview_client [--segment <name>] [--frames <count>] [--output <file.ppm>]
+ *
+ * Waits for the frames published into the shared memory segment (default /project_6_preview) and prints one line per
+ * frame: its size, samples per pixel, camera version and how long after publishing it was read. With --output every
+ * frame overwrites the PPM file, so an image viewer that reloads the file shows the refinement. Exits after --frames
+ * frames (0, the default, runs until the process is stopped). */
+int main(int argc, char* argv[]){
+    std::string segment_name = "/project_6_preview";
+    std::string output_path;
+    long frame_limit = 0;
+    for (int arg = 1; arg + 1 < argc; arg += 2)
+    {
+        if (std::strcmp(argv[arg], "--segment") == 0)
+            segment_name = argv[arg + 1];
+        else if (std::strcmp(argv[arg], "--frames") == 0)
+            frame_limit = std::atol(argv[arg + 1]);
+        else if (std::strcmp(argv[arg], "--output") == 0)
+            output_path = argv[arg + 1];
+        else
+        {
+            std::cerr << "unknown option " << argv[arg] << '\n';
+            return 1;
+        }
+    }
+
+    // the client may be started before the preview; it waits up to five seconds for the segment to appear
+    std::unique_ptr<shared_frame_reader> opened;
+    for (int attempt = 0; !opened; attempt++)
+    {
+        try {
+            opened.reset(new shared_frame_reader(segment_name));
+        }
+        catch (const std::exception& e) {
+            if (attempt == 50)
+            {
+                std::cerr << e.what() << '\n';
+                return 1;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    const shared_frame_reader& reader = *opened;
+
+    try {
+        preview_frame frame;
+
+        for (long frames_read = 0; frame_limit == 0 || frames_read < frame_limit; )
+        {
+            // the writer never waits for readers, so readers poll; 1 ms is well below the time of a frame
+            if (!reader.read(frame))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            frames_read++;
+
+            std::cout << "frame " << frame.generation << ": " << frame.width << 'x' << frame.height << ", "
+                      << frame.samples << " spp, camera " << frame.camera_version << ", read "
+                      << shared_frame_reader::age_milliseconds(frame) << " ms after publishing" << std::endl;
+
+            if (!output_path.empty())
+            {
+                std::ofstream out(output_path, std::ios::binary);
+                ppm_stream_writer writer(out, frame.width, frame.height);
+                writer.write_rows(frame.pixels.data(), frame.height);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "include/unix_socket.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/** Command line client of the render server (project_6 --server).
+ *
+ *   project_6_client [--socket <path>] <request words...>   sends one request, e.g. "render preview out.ppm"
+ *   project_6_client [--socket <path>]                      sends every line of the standard input as a request
+ *
+ * Prints the server response of every request together with the round trip time measured by the client,
+ * which adds the socket and scheduling overhead to the server-side latency in the response. */
+int main(int argc, char* argv[]){
+    std::string socket_path = "/tmp/project_6.sock";
+    int first_word = 1;
+    if (argc >= 3 && std::strcmp(argv[1], "--socket") == 0)
+    {
+        socket_path = argv[2];
+        first_word = 3;
+    }
+
+    int socket_fd;
+    try {
+        socket_fd = connect_unix_socket(socket_path);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    auto send_request = [socket_fd](const std::string& request) {
+        auto start = std::chrono::steady_clock::now();
+        std::string response;
+        if (!write_line(socket_fd, request) || !read_line(socket_fd, response))
+        {
+            std::cerr << "connection to the server was lost\n";
+            return false;
+        }
+        std::chrono::duration<double, std::milli> round_trip = std::chrono::steady_clock::now() - start;
+
+        std::cout << response << "  (round trip " << round_trip.count() << " ms)\n";
+        return response.compare(0, 2, "ok") == 0;
+    };
+
+    bool all_ok = true;
+    if (first_word < argc)
+    {
+        std::string request = argv[first_word];
+        for (int word = first_word + 1; word < argc; word++)
+            request += std::string(" ") + argv[word];
+        all_ok = send_request(request);
+    }
+    else
+    {
+        std::string request;
+        while (std::getline(std::cin, request))
+            if (!request.empty())
+                all_ok = send_request(request) && all_ok;
+    }
+
+    ::close(socket_fd);
+    return all_ok ? 0 : 1;
+}